@@ -5,6 +5,7 @@
 #include "ui_connection.h"
 #include "ui_createzcashconfdialog.h"
 #include "controller.h"
+#include "notifylistener.h"
 
 #include "precompiled.h"
 
@@ -376,13 +377,24 @@ bool ConnectionLoader::startEmbeddedZcashd() {
     });
 
 
+    // The embedded ycashd is told to notify us on its command line, so ycash.conf doesn't hold the
+    // path of this binary, which goes stale when the wallet moves and would be run by any other
+    // ycashd using that ycash.conf. Arguments override ycash.conf, so don't pass them if the user 
+    // set up their own hooks there.
+    auto confLocation = Settings::getInstance()->getZcashdConfLocation();
+    QStringList args;
+    if (!Settings::isInZcashConf(confLocation, "blocknotify"))
+        args << "-blocknotify=" % NotifyListener::notifyCommand("block");
+    if (!Settings::isInZcashConf(confLocation, "walletnotify"))
+        args << "-walletnotify=" % NotifyListener::notifyCommand("wallet");
+
 #ifdef Q_OS_LINUX
-    ezcashd->start(zcashdProgram);
+    ezcashd->start(zcashdProgram, args);
 #elif defined(Q_OS_DARWIN)
-    ezcashd->start(zcashdProgram);
+    ezcashd->start(zcashdProgram, args);
 #else
     ezcashd->setWorkingDirectory(appPath.absolutePath());
-    ezcashd->start("ycashd.exe");
+    ezcashd->start("ycashd.exe", args);
 #endif // Q_OS_LINUX
 
 
@@ -429,23 +441,47 @@ void ConnectionLoader::doRPCSetConnection(Connection* conn) {
     delete this;
 }
 
-Connection* ConnectionLoader::makeConnection(std::shared_ptr<ConnectionConfig> config) {
-    QNetworkAccessManager* client = new QNetworkAccessManager(main);
-         
+QNetworkRequest* ConnectionLoader::makeRequest(const QString& host, const QString& port, 
+                                                const QString& rpcuser, const QString& rpcpassword) {
     QUrl myurl;
     myurl.setScheme("http");
-    myurl.setHost(config.get()->host);
-    myurl.setPort(config.get()->port.toInt());
+    myurl.setHost(host);
+    myurl.setPort(port.toInt());
 
     QNetworkRequest* request = new QNetworkRequest();
     request->setUrl(myurl);
     request->setHeader(QNetworkRequest::ContentTypeHeader, "text/plain");
     
-    QString userpass = config.get()->rpcuser % ":" % config.get()->rpcpassword;
+    QString userpass = rpcuser % ":" % rpcpassword;
     QString headerData = "Basic " + userpass.toLocal8Bit().toBase64();
     request->setRawHeader("Authorization", headerData.toLocal8Bit());    
 
-    return new Connection(main, client, request, config);
+    return request;
+}
+
+Connection* ConnectionLoader::makeConnection(std::shared_ptr<ConnectionConfig> config) {
+    QNetworkAccessManager* client = new QNetworkAccessManager(main);
+
+    QNetworkRequest* request = makeRequest(config->host, config->port, config->rpcuser, config->rpcpassword);
+    auto connection = new Connection(main, client, request, config);
+
+    // Replicas use the primary's credentials unless they have their own
+    for (auto& replica : config->replicas) {
+        QUrl url = QUrl::fromUserInput("http://" + replica.trimmed());
+        if (!url.isValid() || url.host().isEmpty() || url.port() < 0) {
+            main->logger->write("Ignoring invalid replica endpoint " + replica);
+            continue;
+        }
+
+        QString user = url.userName().isEmpty() ? config->rpcuser     : url.userName();
+        QString pass = url.userName().isEmpty() ? config->rpcpassword : url.password();
+
+        main->logger->write("Adding replica endpoint " + url.host() + ":" + QString::number(url.port()));
+        connection->addEndpoint(url.host() % ":" % QString::number(url.port()), 
+                                makeRequest(url.host(), QString::number(url.port()), user, pass));
+    }
+
+    return connection;
 }
 
 void ConnectionLoader::refreshZcashdState(Connection* connection, std::function<void(void)> refused) {
@@ -673,6 +709,8 @@ std::shared_ptr<ConnectionConfig> ConnectionLoader::autoDetectZcashConf() {
     if (zcashconf->port.isEmpty()) zcashconf->port = "8832";
     file.close();
 
+    zcashconf->replicas = Settings::getInstance()->getReplicaEndpoints();
+
     // In addition to the ycash.conf file, also double check the params. 
 
     return std::shared_ptr<ConnectionConfig>(zcashconf);
@@ -693,7 +731,8 @@ std::shared_ptr<ConnectionConfig> ConnectionLoader::loadFromSettings() {
     if (username.isEmpty() || password.isEmpty())
         return nullptr;
 
-    auto uiConfig = new ConnectionConfig{ host, port, username, password, false, false, false, "", "", ConnectionType::UISettingsZCashD};
+    auto uiConfig = new ConnectionConfig{ host, port, username, password, false, false, false, "", "", ConnectionType::UISettingsZCashD,
+                                          Settings::getInstance()->getReplicaEndpoints() };
 
     return std::shared_ptr<ConnectionConfig>(uiConfig);
 }
@@ -711,11 +750,355 @@ Connection::Connection(MainWindow* m, QNetworkAccessManager* c, QNetworkRequest*
     this->request     = r;
     this->config      = conf;
     this->main        = m;
+
+    this->scheduler   = new RPCScheduler(Settings::getInstance()->getMaxRPCsInFlight());
+    this->metrics     = new RPCMetrics();
+    this->metrics->setScheduler(scheduler);
+
+    addEndpoint(conf->host % ":" % conf->port, r);
 }
 
 Connection::~Connection() {
     delete restclient;
-    delete request;
+    delete scheduler;
+    delete metrics;
+
+    // The primary's request is one of the endpoints
+    for (auto endpoint : endpoints) {
+        delete endpoint->pipeline;
+        delete endpoint->request;
+        delete endpoint;
+    }
+}
+
+void Connection::addEndpoint(const QString& name, QNetworkRequest* r) {
+    auto endpoint = new RPCEndpoint();
+    endpoint->name    = name;
+    endpoint->request = r;
+
+    if (Settings::getInstance()->getUsePipelinedRPC())
+        endpoint->pipeline = new RPCPipeline(*r, Settings::pipelinedConnections);
+
+    endpoints.append(endpoint);
+}
+
+/**
+ * Queue an HTTP request to ycashd on the scheduler. onFinished is called with the reply once
+ * it has finished, and the reply is deleted afterwards. method is the RPC method, or
+ * "batch:<method>" for a batch array.
+ *
+ * Read-only calls are aborted if they take longer than Settings::rpcTimeout, and onFinished sees
+ * the OperationCanceledError. A chunk of a batch is given the batch's watchdog instead, since a 
+ * big chunk on a busy ycashd can take longer than that. It is only aborted when the watchdog fires,
+ * that is when the whole batch stopped making progress. Calls made for a refresh, that is inside 
+ * withGeneration(), are dropped without calling onFinished once a newer refresh generation has 
+ * started, see newRefreshGeneration().
+ */
+void Connection::sendRPC(const QString& method, const QByteArray& body, RPCPriority priority,
+                            const std::function<void(QNetworkReply*)>& onFinished, QTimer* watchdog) {
+    auto rpc = std::make_shared<OutgoingRPC>();
+    rpc->method      = method;
+    rpc->rpcMethod   = method.startsWith("batch:") ? method.mid(6) : method;
+    rpc->body        = body;
+    rpc->hasDeadline = isReadOnlyMethod(rpc->rpcMethod) && watchdog == nullptr;
+    rpc->watchdog    = watchdog;
+    rpc->generation  = issuing;
+    rpc->cancellable = issuing != 0 && isCancellable(rpc->rpcMethod);
+    rpc->onFinished  = onFinished;
+
+    scheduler->submit(priority, [=] (std::function<void(void)> done) {
+        if (shutdownInProgress) {
+            done();
+            return;
+        }
+
+        // A newer refresh started while this was queued, so nobody is waiting for the answer anymore
+        if (rpc->cancellable && rpc->generation != refreshGeneration) {
+            metrics->cancelled(method);
+            done();
+            return;
+        }
+
+        rpc->done = done;
+        post(rpc, pickEndpoint(rpc->rpcMethod));
+    });
+}
+
+void Connection::post(std::shared_ptr<OutgoingRPC> rpc, RPCEndpoint* endpoint) {
+    // Latency is measured from when the request goes on the wire, not from when it was queued
+    QElapsedTimer sent;
+    sent.start();
+    metrics->started(rpc->method, rpc->body.size());
+
+    if (!isReadOnlyMethod(rpc->rpcMethod))
+        walletChangedAt.start();
+
+    QNetworkReply *reply = endpoint->pipeline ? endpoint->pipeline->post(rpc->body)
+                                              : restclient->post(*endpoint->request, rpc->body);
+
+    if (rpc->cancellable)
+        liveReplies[reply] = rpc->generation;
+
+    auto timedOut = std::make_shared<bool>(false);
+    if (rpc->hasDeadline) {
+        // The timer goes away with the reply, so it can only fire while the call is outstanding
+        QTimer::singleShot(Settings::rpcTimeout, reply, [=] () {
+            qDebug() << rpc->method << "timed out on" << endpoint->name << "after" << sent.elapsed() << "ms";
+            *timedOut = true;
+            metrics->timedOut(rpc->method);
+            reply->abort();
+        });
+    } else if (rpc->watchdog) {
+        // The batch gave up. This doesn't count against the endpoint, the batch was just too slow.
+        QObject::connect(rpc->watchdog, &QTimer::timeout, reply, [=] () {
+            metrics->timedOut(rpc->method);
+            reply->abort();
+        });
+    }
+
+    QObject::connect(reply, &QNetworkReply::finished, [=] {
+        liveReplies.remove(reply);
+
+        if (!isReadOnlyMethod(rpc->rpcMethod))
+            walletChangedAt.start();
+
+        metrics->finished(rpc->method, sent.elapsed(), reply->bytesAvailable(),
+                            reply->error() != QNetworkReply::NoError);
+        reply->deleteLater();
+
+        if (rpc->cancellable && rpc->generation != refreshGeneration) {
+            metrics->cancelled(rpc->method);
+            rpc->done();
+            return;
+        }
+
+        auto err = reply->error();
+        bool unreachable = *timedOut || (err > QNetworkReply::NoError && err < QNetworkReply::ProxyConnectionRefusedError &&
+                                         err != QNetworkReply::OperationCanceledError);
+        if (unreachable) {
+            bool failedOver = endpointFailed(endpoint, rpc->rpcMethod);
+
+            // A replica couldn't be reached, so ask the primary instead. If this was the primary, 
+            // and a replica just took its place, ask the new primary, even if the call timed out, 
+            // so the caller doesn't see the connection as lost.
+            if ((failedOver || (!*timedOut && endpoint != endpoints.first())) && !shutdownInProgress) {
+                post(rpc, endpoints.first());
+                return;
+            }
+        } else {
+            endpointAnswered(endpoint, sent.elapsed());
+        }
+
+        // Transient failures of calls that can safely be sent again are retried after a while. 
+        // The call keeps its place in the scheduler in the meantime, which also eases the load on ycashd.
+        if (!*timedOut && shouldRetry(*rpc, reply, unreachable)) {
+            int delay = retryDelay(rpc->attempts++);
+            qDebug() << "Retrying" << rpc->method << "in" << delay << "ms after" << reply->errorString();
+            metrics->retried(rpc->method);
+
+            QTimer::singleShot(delay, main, [=] () {
+                if (shutdownInProgress || (rpc->cancellable && rpc->generation != refreshGeneration)) {
+                    metrics->cancelled(rpc->method);
+                    rpc->done();
+                    return;
+                }
+
+                post(rpc, pickEndpoint(rpc->rpcMethod));
+            });
+            return;
+        }
+
+        rpc->done();
+
+        // Whatever the callback sends next belongs to the same refresh
+        withGeneration(rpc->generation, [&] () { rpc->onFinished(reply); });
+    });
+}
+
+/**
+ * Whether a failed call should be sent again. Only idempotent calls are retried, and only for 
+ * errors that are likely to go away: ycashd couldn't be reached, or was too busy to take the call.
+ */
+bool Connection::shouldRetry(const OutgoingRPC& rpc, QNetworkReply* reply, bool unreachable) {
+    if (shutdownInProgress || rpc.attempts >= Settings::maxRPCRetries || !isIdempotent(rpc.rpcMethod))
+        return false;
+
+    if (unreachable)
+        return true;
+
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 503)
+        return true;
+
+    // Batches back off from a full work queue by shrinking their window instead, see runBatch()
+    return isWorkQueueFull(reply) && !rpc.method.startsWith("batch:");
+}
+
+/**
+ * Exponential backoff with jitter, so calls that failed together don't all come back at once
+ */
+int Connection::retryDelay(int attempts) {
+    int ceiling = std::min(Settings::rpcRetryBaseDelay << std::min(attempts, 10), Settings::rpcRetryMaxDelay);
+    return ceiling / 2 + static_cast<int>(QRandomGenerator::global()->bounded(ceiling / 2 + 1));
+}
+
+/**
+ * Calls that can be sent again without changing the outcome. getinfo and getrescaninfo are left 
+ * out, because their failures are how a ycashd that went away is noticed.
+ */
+bool Connection::isIdempotent(const QString& method) {
+    return isReadOnlyMethod(method) && method != "getinfo" && method != "getrescaninfo";
+}
+
+/**
+ * Pick the endpoint to send a call to. Calls that aren't read-only always go to the primary, and so
+ * do reads for Settings::primaryAfterWrite after one of them, so they see what it changed. Other
+ * read-only calls are spread over the endpoints that are up, weighted by how fast each one has 
+ * been answering. An endpoint that is down gets another chance after Settings::endpointRetryDelay.
+ */
+RPCEndpoint* Connection::pickEndpoint(const QString& method) {
+    if (endpoints.size() == 1 || isPinnedToPrimary(method))
+        return endpoints.first();
+
+    if (walletChangedAt.isValid() && walletChangedAt.elapsed() < Settings::primaryAfterWrite)
+        return endpoints.first();
+
+    QList<RPCEndpoint*> candidates;
+    QList<double>       weights;
+    double              total = 0;
+    for (auto endpoint : endpoints) {
+        if (endpoint->down && endpoint->downSince.elapsed() < Settings::endpointRetryDelay)
+            continue;
+
+        candidates.append(endpoint);
+        weights.append(1.0 / (1.0 + endpoint->latencyMs));
+        total += weights.last();
+    }
+
+    if (candidates.isEmpty())
+        return endpoints.first();
+
+    double r = QRandomGenerator::global()->generateDouble() * total;
+    for (int i = 0; i < candidates.size(); i++) {
+        r -= weights[i];
+        if (r <= 0)
+            return candidates[i];
+    }
+
+    return candidates.last();
+}
+
+void Connection::endpointAnswered(RPCEndpoint* endpoint, qint64 elapsedMs) {
+    if (endpoint->down) {
+        main->logger->write("ycashd at " + endpoint->name + " is answering again");
+        endpoint->down = false;
+    }
+
+    // Exponential moving average, so one slow call doesn't starve an endpoint
+    endpoint->latencyMs = endpoint->latencyMs == 0 ? elapsedMs : 0.8 * endpoint->latencyMs + 0.2 * elapsedMs;
+}
+
+/**
+ * Mark an endpoint as down. Returns true if it was the primary, and another endpoint took its place.
+ */
+bool Connection::endpointFailed(RPCEndpoint* endpoint, const QString& method) {
+    if (!endpoint->down)
+        main->logger->write("ycashd at " + endpoint->name + " is not answering " + method);
+
+    endpoint->down = true;
+    endpoint->downSince.start();
+
+    // The primary is checked with getinfo on every refresh. If it stops answering that, 
+    // move to the next endpoint that is still up.
+    if (endpoint == endpoints.first() && method == "getinfo")
+        return failOver();
+
+    return false;
+}
+
+bool Connection::failOver() {
+    for (int i = 1; i < endpoints.size(); i++) {
+        if (endpoints[i]->down)
+            continue;
+
+        main->logger->write("Failing over from ycashd at " + endpoints.first()->name + " to " + endpoints[i]->name);
+        endpoints.swap(0, i);
+        request = endpoints.first()->request;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Calls that have to go to the primary even though they don't change anything. getinfo is how 
+ * the primary's health is checked, and the rescan state and async operations are per-node. 
+ * Calls about blocks are too: the tx history's listsinceblock anchor, the tx cache's reorg check 
+ * and the block height lookups use hashes the primary gave, and a replica that is a few blocks 
+ * behind doesn't know those blocks yet.
+ */
+bool Connection::isPinnedToPrimary(const QString& method) {
+    return !isReadOnlyMethod(method) || 
+           method == "getinfo" || method == "getrescaninfo" || method == "z_getoperationstatus" ||
+           method == "listsinceblock" || method == "getbestblockhash" || method == "getblockhash" ||
+           method == "getblockheader";
+}
+
+/**
+ * Start a new refresh generation. Calls made for earlier refreshes are aborted if they are on the
+ * wire, dropped if they are still queued, and their callbacks never run. Calls that weren't made
+ * for a refresh, like interactive calls, key exports and the rescan probe, are left alone.
+ */
+void Connection::newRefreshGeneration() {
+    refreshGeneration++;
+
+    // Callers from earlier refreshes that are waiting on a shared read are forgotten. A read that 
+    // was sent for an earlier refresh is about to be aborted, so if someone else joined it, like a 
+    // key export joining the address refresh's z_listaddresses, it is sent again just for them.
+    for (auto& key : inFlightReads.keys()) {
+        auto& read = inFlightReads[key];
+
+        QList<PendingRead> waiting;
+        for (auto& waiter : read.waiters) {
+            if (!isStale(waiter.generation))
+                waiting.append(waiter);
+        }
+        read.waiters = waiting;
+
+        if (!isStale(read.generation) || !isCancellable(read.method))
+            continue;
+
+        if (waiting.isEmpty()) {
+            inFlightReads.remove(key);
+            continue;
+        }
+
+        int id          = nextReadId++;
+        read.id         = id;
+        read.generation = 0;
+        withGeneration(0, [&] () {
+            whenNotRescanning([=] () { sendSharedRead(key, id); });
+        });
+    }
+
+    // Aborting emits finished right away, which removes the reply from liveReplies
+    for (auto reply : liveReplies.keys()) {
+        reply->abort();
+    }
+}
+
+void Connection::withGeneration(int generation, const std::function<void(void)>& fn) {
+    int outer = issuing;
+    issuing   = generation;
+    fn();
+    issuing   = outer;
+}
+
+/**
+ * Whether a call to this method can be dropped when a newer refresh generation starts, if it was
+ * made for a refresh. Calls that weren't made for one are never dropped.
+ */
+bool Connection::isCancellable(const QString& method) {
+    return isReadOnlyMethod(method) && method != "getrescaninfo";
 }
 
 void Connection::doRPCDirect(const json& payload, const std::function<void(json)>& cb, 
@@ -725,10 +1108,10 @@ void Connection::doRPCDirect(const json& payload, const std::function<void(json)
         return;
     }
 
-    QNetworkReply *reply = restclient->post(*request, QByteArray::fromStdString(payload.dump()));
+    auto method   = QString::fromStdString(payload["method"].get<json::string_t>());
+    auto priority = RPCScheduler::priorityForMethod(method);
 
-    QObject::connect(reply, &QNetworkReply::finished, [=] {
-        reply->deleteLater();
+    sendRPC(method, QByteArray::fromStdString(payload.dump()), priority, [=] (QNetworkReply* reply) {
         if (shutdownInProgress) {
             // Ignoring callback because shutdown in progress
             return;
@@ -741,7 +1124,10 @@ void Connection::doRPCDirect(const json& payload, const std::function<void(json)
             return;
         } 
         
-        auto parsed = json::parse(reply->readAll(), nullptr, false);
+        auto body   = readReply(reply);
+        auto parsed = json::parse(body.constBegin(), body.constEnd(), nullptr, false);
+        recycleBuffer(body);
+
         if (parsed.is_discarded()) {
             ne(reply, "Unknown error");
         }
@@ -750,6 +1136,246 @@ void Connection::doRPCDirect(const json& payload, const std::function<void(json)
     });
 }
 
+/**
+ * Like doRPCDirect, but hands the raw reply body to cb, so that it can be decoded without
+ * building a json DOM.
+ */
+void Connection::doRPCDirectRaw(const json& payload, const std::function<void(const QByteArray&)>& cb, 
+                                const std::function<void(QNetworkReply*, const json&)>& ne) {
+    doRPCDirectRaw(QString::fromStdString(payload["method"].get<json::string_t>()), 
+                    QByteArray::fromStdString(payload.dump()), cb, ne);
+}
+
+void Connection::doRPCDirectRaw(const QString& method, const QByteArray& body, 
+                                const std::function<void(const QByteArray&)>& cb, 
+                                const std::function<void(QNetworkReply*, const json&)>& ne) {
+    if (shutdownInProgress) {
+        // Ignoring RPC because shutdown in progress
+        return;
+    }
+
+    auto priority = RPCScheduler::priorityForMethod(method);
+
+    sendRPC(method, body, priority, [=] (QNetworkReply* reply) {
+        if (shutdownInProgress) {
+            // Ignoring callback because shutdown in progress
+            return;
+        }
+        
+        if (reply->error() != QNetworkReply::NoError) {
+            auto parsed = json::parse(reply->readAll(), nullptr, false);
+            ne(reply, parsed);
+            
+            return;
+        } 
+
+        auto body = readReply(reply);
+        cb(body);
+        recycleBuffer(body);
+    });
+}
+
+/**
+ * Send a JSON-RPC batch array in a single HTTP request. cb gets the raw reply body, and ne the
+ * reply if the request failed.
+ */
+void Connection::doRPCBatchArray(const json& batch, const std::function<void(const QByteArray&)>& cb,
+                                    const std::function<void(QNetworkReply*)>& ne, RPCPriority priority,
+                                    QTimer* watchdog) {
+    if (shutdownInProgress) {
+        // Ignoring RPC because shutdown in progress
+        return;
+    }
+
+    QString method = "batch";
+    if (!batch.empty() && batch[0].is_object())
+        method += ":" % QString::fromStdString(batch[0].value("method", ""));
+
+    sendRPC(method, QByteArray::fromStdString(batch.dump()), priority, [=] (QNetworkReply* reply) {
+        if (shutdownInProgress) {
+            // Ignoring callback because shutdown in progress
+            return;
+        }
+
+        if (reply->error() != QNetworkReply::NoError) {
+            qDebug() << "Batch RPC failed:" << reply->errorString();
+            ne(reply);
+            return;
+        }
+
+        auto body = readReply(reply);
+        cb(body);
+        recycleBuffer(body);
+    }, watchdog);
+}
+
+/**
+ * Run a batch a window of chunks at a time. The window adapts to how fast ycashd answers, and
+ * chunks that ycashd turns away because its work queue is full are sent again later, so very
+ * large batches like exporting all keys don't overrun ycashd or pile up replies.
+ */
+void Connection::runBatch(std::shared_ptr<BatchJob> job) {
+    job->generation  = issuing;
+    job->cancellable = issuing != 0 && isCancellable(job->method);
+    job->window      = BatchWindow(job->numChunks, Settings::getInstance()->getMaxRPCsInFlight());
+
+    // Batches are held back like any other RPC while ycashd is rescanning
+    whenNotRescanning([=] () {
+        // Make sure a single lost reply can't stall the caller forever. The deadline starts over 
+        // every time a chunk is answered, so a long batch that keeps making progress isn't cut short.
+        job->watchdog = new QTimer(main);
+        job->watchdog->setSingleShot(true);
+        QObject::connect(job->watchdog, &QTimer::timeout, [=] () {
+            qDebug() << "Batch" << job->method << "timed out with" << job->window.inFlight() << "chunks outstanding";
+            finishBatch(job);
+        });
+        job->watchdog->start(Settings::batchRPCTimeout);
+
+        pumpBatch(job);
+    });
+}
+
+void Connection::pumpBatch(std::shared_ptr<BatchJob> job) {
+    if (job->completed)
+        return;
+
+    if (job->window.done() || shutdownInProgress || 
+            (job->cancellable && job->generation != refreshGeneration)) {
+        finishBatch(job);
+        return;
+    }
+
+    int chunk;
+    while ((chunk = job->window.take()) >= 0) {
+        QElapsedTimer sent;
+        sent.start();
+
+        auto fnAnswered = [=] (const QByteArray& body) {
+            if (job->completed)
+                return;
+
+            job->chunkAnswered(chunk, body);
+            job->window.answered(chunk, sent.elapsed());
+            job->watchdog->start();
+            pumpBatch(job);
+        };
+
+        auto fnFailed = [=] (QNetworkReply* reply) {
+            if (job->completed)
+                return;
+
+            if (isWorkQueueFull(reply)) {
+                if (job->window.rejected(chunk)) {
+                    qDebug() << "ycashd's work queue is full, retrying" << job->method << "chunk" << chunk
+                             << "in" << job->window.retryDelay() << "ms";
+                    QTimer::singleShot(job->window.retryDelay(), main, [=] () { pumpBatch(job); });
+                    return;
+                }
+
+                main->logger->write("Giving up on part of " + job->method + ", ycashd's work queue stayed full");
+            } else {
+                job->window.failed(chunk);
+            }
+
+            job->watchdog->start();
+            pumpBatch(job);
+        };
+
+        // The chunks belong to the refresh the batch was started for, wherever they're sent from
+        withGeneration(job->generation, [&] () {
+            doRPCBatchArray(job->buildChunk(chunk), fnAnswered, fnFailed, RPCPriority::Background, job->watchdog);
+        });
+    }
+}
+
+void Connection::finishBatch(std::shared_ptr<BatchJob> job) {
+    if (job->completed)
+        return;
+
+    job->completed = true;
+
+    if (job->watchdog) {
+        job->watchdog->stop();
+        job->watchdog->deleteLater();
+        job->watchdog = nullptr;
+    }
+
+    bool dropped = shutdownInProgress || (job->cancellable && job->generation != refreshGeneration);
+    job->complete(dropped);
+
+    // The closures hold on to the caller's data, which isn't needed anymore
+    job->buildChunk    = nullptr;
+    job->chunkAnswered = nullptr;
+    job->complete      = nullptr;
+}
+
+/**
+ * ycashd turns HTTP requests away with a 500 and this plain text message when all its RPC 
+ * worker threads are busy and its queue is full.
+ */
+bool Connection::isWorkQueueFull(QNetworkReply* reply) {
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 500 &&
+           reply->peek(256).contains("Work queue depth exceeded");
+}
+
+/**
+ * Read the body of a finished reply into a buffer from the pool, instead of letting readAll()
+ * allocate a new one for every reply. Hand the buffer back with recycleBuffer() when done with it.
+ */
+QByteArray Connection::readReply(QNetworkReply* reply) {
+    QByteArray buf = bufferPool.isEmpty() ? QByteArray() : bufferPool.takeLast();
+
+    qint64 size = reply->bytesAvailable();
+
+    // Marks the capacity as reserved, so it is kept when the buffer is shrunk for a smaller reply
+    buf.reserve(static_cast<int>(size));
+    buf.resize(static_cast<int>(size));
+
+    qint64 read = reply->read(buf.data(), size);
+    buf.resize(static_cast<int>(std::max<qint64>(read, 0)));
+
+    return buf;
+}
+
+void Connection::recycleBuffer(QByteArray& buf) {
+    // A buffer the callback kept a copy of is still in use. Very large ones aren't worth holding on to.
+    if (!buf.isDetached() || buf.capacity() > maxPooledBufferSize || bufferPool.size() >= maxPooledBuffers)
+        return;
+
+    bufferPool.append(std::move(buf));
+}
+
+/**
+ * Parse a batch reply into a json DOM. ycashd answers with an array of responses in no particular
+ * order, so they are returned keyed by the integer id of each call. Calls that returned an error,
+ * or a batch that failed entirely, are left out of the map.
+ */
+QMap<int, json> Connection::decodeBatchReply(const QByteArray& body) {
+    QMap<int, json> results;
+
+    auto parsed = json::parse(body.constBegin(), body.constEnd(), nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_array())
+        return results;
+
+    for (auto& item : parsed.get<json::array_t>()) {
+        if (!item.is_object() || !item["id"].is_number_integer())
+            continue;
+
+        if (!item["error"].is_null()) {
+            qDebug() << QString::fromStdString(item["error"].dump());
+            continue;
+        }
+
+        results[item["id"].get<json::number_integer_t>()] = item["result"];
+    }
+
+    return results;
+}
+
+int Connection::batchChunkSize() {
+    return std::max(1, Settings::getInstance()->getRPCBatchSize());
+}
+
 /**
  * Do a safe RPC call so that it doesn't accidentally block. If the ycashd is doing a 
  * rescan, other RPC calls are likely to block till the rescan is finished, which might
@@ -765,37 +1391,241 @@ void Connection::doRPCSafe(const json& payload, const std::function<void(json)>&
         return;
     }
 
-    // Check rescaninfo first
-    json rescanPayload = {
+    if (!isReadOnlyMethod(payloadMethod)) {
+        whenNotRescanning([=] () {
+            this->doRPCDirect(payload, cb, ne);
+        });
+        return;
+    }
+
+    readShared(payloadMethod, payload.value("params", json::array()), QByteArray::fromStdString(payload.dump()), 
+        PendingRead{ [=] (QNetworkReply* reply, const QByteArray& body) {
+            auto parsed = json::parse(body.constBegin(), body.constEnd(), nullptr, false);
+            if (parsed.is_discarded()) {
+                ne(reply, "Unknown error");
+                return;
+            }
+
+            cb(parsed["result"]);
+        }, ne });
+}
+
+/**
+ * Send a read-only call, unless an identical one is already outstanding, in which case just wait 
+ * for its result. The json and the raw callers share one map, so a call made either way joins one
+ * made the other way. The params are dumped with sorted object keys, so equal params always 
+ * produce the same key, however the request body was written.
+ */
+void Connection::readShared(const QString& method, const json& params, const QByteArray& body, 
+                                const PendingRead& waiter) {
+    QString key = method % ":" % QString::fromStdString(params.dump());
+    PendingRead tagged = waiter;
+    tagged.generation  = issuing;
+
+    if (inFlightReads.contains(key)) {
+        inFlightReads[key].waiters.append(tagged);
+        metrics->coalesced(method);
+        return;
+    }
+
+    int id = nextReadId++;
+    inFlightReads[key] = InFlightRead{ id, method, body, issuing, QList<PendingRead>{ tagged } };
+
+    whenNotRescanning([=] () { sendSharedRead(key, id); });
+}
+
+void Connection::sendSharedRead(const QString& key, int id) {
+    // The entry was dropped while the call was parked
+    if (!inFlightReads.contains(key) || inFlightReads[key].id != id)
+        return;
+
+    auto read = inFlightReads[key];
+    withGeneration(read.generation, [&] () {
+        sendRPC(read.method, read.body, RPCScheduler::priorityForMethod(read.method), [=] (QNetworkReply* reply) {
+            deliverSharedRead(key, id, reply);
+        });
+    });
+}
+
+/**
+ * Hand the answer to a shared read to everyone waiting on it. Each waiter's callback runs in the 
+ * refresh generation it was made in, whichever one the request was sent for.
+ */
+void Connection::deliverSharedRead(const QString& key, int id, QNetworkReply* reply) {
+    if (shutdownInProgress) {
+        // Ignoring callback because shutdown in progress
+        return;
+    }
+
+    if (!inFlightReads.contains(key) || inFlightReads[key].id != id)
+        return;
+
+    auto waiters = inFlightReads.take(key).waiters;
+
+    if (reply->error() != QNetworkReply::NoError) {
+        auto parsed = json::parse(reply->readAll(), nullptr, false);
+        for (auto& waiter : waiters) {
+            withGeneration(waiter.generation, [&] () { waiter.ne(reply, parsed); });
+        }
+        return;
+    }
+
+    auto body = readReply(reply);
+    for (auto& waiter : waiters) {
+        withGeneration(waiter.generation, [&] () { waiter.cb(reply, body); });
+    }
+    recycleBuffer(body);
+}
+
+/**
+ * Methods that don't change any wallet or node state. Identical concurrent calls to these
+ * can safely share one request. Anything not listed here, like z_sendmany or z_getnewaddress, 
+ * is always sent as its own request.
+ */
+bool Connection::isReadOnlyMethod(const QString& method) {
+    static const QSet<QString> readOnly = {
+        "getinfo", "getblockchaininfo", "getnetworksolps", "getrescaninfo",
+        "z_gettotalbalance", "listunspent", "z_listunspent", "listtransactions",
+        "z_listaddresses", "getaddressesbyaccount", "z_listreceivedbyaddress", "gettransaction",
+        "z_getoperationstatus", "z_getmigrationstatus", "validateaddress", "z_validateaddress",
+        "dumpprivkey", "z_exportkey", "z_exportviewingkey", "z_exportivk", "getblockhash",
+        "getbestblockhash", "listsinceblock", "getblockheader"
+    };
+
+    return readOnly.contains(method);
+}
+
+/**
+ * Run fn once ycashd is known not to be rescanning. The rescan state is cached for 
+ * Settings::rescanStatusTTL, so most calls run right away. When the cache is stale, fn is parked
+ * and a single getrescaninfo probe is sent for everyone waiting. If a rescan is running, the 
+ * parked calls stay parked and are released when the rescan finishes.
+ */
+void Connection::whenNotRescanning(const std::function<void(void)>& fn) {
+    if (shutdownInProgress) {
+        // Ignoring RPC because shutdown in progress
+        return;
+    }
+
+    bool fresh = !rescanInfoSupported || 
+                 (rescanCheckedAt.isValid() && rescanCheckedAt.elapsed() < Settings::rescanStatusTTL);
+    if (fresh && !rescanning) {
+        fn();
+        return;
+    }
+
+    // It runs in the refresh it was made for, whenever it's released
+    int generation = issuing;
+    parkedRPCs.append([=] () { withGeneration(generation, fn); });
+
+    // If a rescan is running, a re-probe is already scheduled
+    if (!fresh)
+        probeRescanStatus();
+}
+
+void Connection::probeRescanStatus() {
+    if (rescanProbeInFlight)
+        return;
+
+    rescanProbeInFlight = true;
+
+    json payload = {
         {"jsonrpc", "1.0"},
         {"id", "someid"},
         {"method", "getrescaninfo"}
     };
-    doRPCDirect(rescanPayload, 
+    doRPCDirect(payload, 
         [=] (const json& reply) {
-            if (reply["rescanning"].get<json::boolean_t>()) {
+            rescanProbeInFlight = false;
+            rescanCheckedAt.start();
+            rescanning = reply.is_object() && reply.value("rescanning", false);
+
+            if (rescanning) {
                 this->main->getRPC()->refreshRescanStatus();
-                return;
+
+                // Keep polling while the rescan runs, so the parked calls are released when it's done
+                QTimer::singleShot(Settings::rescanStatusTTL, main, [=] () { this->probeRescanStatus(); });
             } else {
                 this->main->getRPC()->closeRefreshStatusIfAlive();
-                this->doRPCDirect(payload, cb, ne);
+                this->releaseParkedRPCs();
             }
         },
-        [=] (auto, auto) {
-            // If it errors out, then the ycashd probably doesn't support it yet,
-            // so just do the original thing
-            this->doRPCDirect(payload, cb, ne);
+        [=] (auto, const json& parsed) {
+            rescanProbeInFlight = false;
+            rescanCheckedAt.start();
+            rescanning = false;
+
+            // If ycashd doesn't know the method, it's too old to support it, so don't ask again.
+            // Any other error just lets the waiting calls go through, where they'll report their own errors
+            json error = parsed.is_object() ? parsed.value("error", json()) : json();
+            if (error.is_object() && error.value("code", 0) == -32601) {
+                rescanInfoSupported = false;
+            }
+
+            this->releaseParkedRPCs();
         }
     );
 }
 
+void Connection::releaseParkedRPCs() {
+    auto parked = parkedRPCs;
+    parkedRPCs.clear();
+
+    for (auto& fn : parked) {
+        fn();
+    }
+}
+
+void Connection::doRPCSafeRaw(const json& payload, const std::function<void(const QByteArray&)>& cb, 
+                            const std::function<void(QNetworkReply*, const json&)>& ne) {
+    doRPCSafeRaw(QString::fromStdString(payload["method"].get<json::string_t>()), 
+                    QByteArray::fromStdString(payload.dump()), cb, ne);
+}
+
+/**
+ * The raw version of doRPCSafe. Identical read-only calls share one request with the json callers too.
+ */
+void Connection::doRPCSafeRaw(const QString& method, const QByteArray& body, 
+                                const std::function<void(const QByteArray&)>& cb, 
+                                const std::function<void(QNetworkReply*, const json&)>& ne) {
+    // Allow the rescan request to go through
+    if (method == "getrescaninfo" || method == "stop") {
+        doRPCDirectRaw(method, body, cb, ne);
+        return;
+    }
+
+    if (!isReadOnlyMethod(method)) {
+        whenNotRescanning([=] () {
+            this->doRPCDirectRaw(method, body, cb, ne);
+        });
+        return;
+    }
+
+    // The typed requests are small, so reading their params back is cheap
+    auto request = json::parse(body.constBegin(), body.constEnd(), nullptr, false);
+    json params  = request.is_object() ? request.value("params", json::array()) : json::array();
+
+    readShared(method, params, body, PendingRead{ [=] (QNetworkReply*, const QByteArray& reply) {
+        cb(reply);
+    }, ne });
+}
+
+void Connection::doRPCRawWithDefaultErrorHandling(const json& payload, const std::function<void(const QByteArray&)>& cb) {
+    doRPCRawWithDefaultErrorHandling(QString::fromStdString(payload["method"].get<json::string_t>()), 
+                                        QByteArray::fromStdString(payload.dump()), cb);
+}
+
+void Connection::doRPCRawWithDefaultErrorHandling(const QString& method, const QByteArray& body, 
+                                                    const std::function<void(const QByteArray&)>& cb) {
+    doRPCSafeRaw(method, body, cb, [=] (QNetworkReply* reply, const json& parsed) {
+        reportError(method, reply, parsed);
+    });
+}
+
 void Connection::doRPCWithDefaultErrorHandling(const json& payload, const std::function<void(json)>& cb) {
-    doRPCSafe(payload, cb, [=] (auto reply, auto parsed) {
-        if (!parsed.is_discarded() && !parsed["error"]["message"].is_null()) {
-            this->showTxError(QString::fromStdString(parsed["error"]["message"]));    
-        } else {
-            this->showTxError(reply->errorString());
-        }
+    auto method = QString::fromStdString(payload["method"].get<json::string_t>());
+    doRPCSafe(payload, cb, [=] (QNetworkReply* reply, const json& parsed) {
+        reportError(method, reply, parsed);
     });
 }
 
@@ -805,6 +1635,25 @@ void Connection::doRPCIgnoreError(const json& payload, const std::function<void(
     });
 }
 
+/**
+ * What the calls with default error handling do when they fail. Calls that timed out are asked 
+ * again on the next refresh, so don't pop up an error for them. reply is null if the call was 
+ * answered, but the answer couldn't be decoded.
+ */
+void Connection::reportError(const QString& method, QNetworkReply* reply, const json& parsed) {
+    if (reply != nullptr && reply->error() == QNetworkReply::OperationCanceledError) {
+        main->logger->write("RPC " + method + " timed out");
+        return;
+    }
+
+    json error = parsed.is_object() ? parsed.value("error", json()) : json();
+    if (error.is_object() && error.value("message", json()).is_string()) {
+        this->showTxError(QString::fromStdString(error["message"].get<json::string_t>()));
+    } else if (reply != nullptr) {
+        this->showTxError(reply->errorString());
+    }
+}
+
 void Connection::showTxError(const QString& error) {
     if (error.isNull()) return;
 
@@ -2,6 +2,12 @@
 #define CONNECTION_H
 
 #include "mainwindow.h"
+#include "settings.h"
+#include "rpcscheduler.h"
+#include "rpcmetrics.h"
+#include "rpcpipeline.h"
+#include "rpcbatchwindow.h"
+#include "workerpool.h"
 #include "ui_connection.h"
 #include "precompiled.h"
 
@@ -27,10 +33,69 @@ struct ConnectionConfig {
     QString proxy;
 
     ConnectionType connType;
+
+    // Extra ycashd endpoints for read-only calls, as [user:password@]host:port
+    QStringList replicas;
 };
 
 class Connection;
 
+// A ycashd that RPCs can be sent to
+struct RPCEndpoint {
+    QString             name;           // host:port
+    QNetworkRequest*    request;
+    RPCPipeline*        pipeline    = nullptr;  // Used instead of the QNetworkAccessManager if set
+    double              latencyMs   = 0;    // Moving average of successful calls
+    bool                down        = false;
+    QElapsedTimer       downSince;
+};
+
+// An RPC on its way to ycashd. It may be sent more than once if an endpoint fails.
+struct OutgoingRPC {
+    QString                                 method;         // Label used for the metrics
+    QString                                 rpcMethod;
+    QByteArray                              body;
+    bool                                    hasDeadline;
+    QPointer<QTimer>                        watchdog;       // A batch's watchdog, which aborts the call instead
+    bool                                    cancellable;
+    int                                     generation;     // The refresh it was made for, 0 if none
+    int                                     attempts    = 0;    // Retries so far
+    std::function<void(QNetworkReply*)>     onFinished;
+    std::function<void(void)>               done;
+};
+
+// A batch split into chunks that are sent a window at a time, see Connection::runBatch()
+struct BatchJob {
+    QString                                         method;
+    int                                             numChunks;
+    std::function<json(int)>                        buildChunk;
+    std::function<void(int, const QByteArray&)>     chunkAnswered;
+    std::function<void(bool)>                       complete;       // true if the batch was dropped
+
+    bool                                            cancellable     = false;
+    int                                             generation      = 0;
+    bool                                            completed       = false;
+    BatchWindow                                     window;
+    QTimer*                                         watchdog        = nullptr;
+};
+
+// A caller waiting on an in-flight read-only RPC. Callers made through doRPCSafe parse the raw
+// reply body themselves, so they can share a request with callers made through doRPCSafeRaw.
+struct PendingRead {
+    std::function<void(QNetworkReply*, const QByteArray&)>  cb;
+    std::function<void(QNetworkReply*, const json&)>        ne;
+    int                                                     generation  = 0;
+};
+
+// A read-only RPC that is in flight, and everyone waiting on its answer
+struct InFlightRead {
+    int                 id;
+    QString             method;
+    QByteArray          body;
+    int                 generation;     // The request was sent for this refresh, 0 if for none
+    QList<PendingRead>  waiters;
+};
+
 class ConnectionLoader {
 
 public:
@@ -44,6 +109,8 @@ private:
     std::shared_ptr<ConnectionConfig> loadFromSettings();
 
     Connection* makeConnection(std::shared_ptr<ConnectionConfig> config);
+    static QNetworkRequest* makeRequest(const QString& host, const QString& port, 
+                                        const QString& rpcuser, const QString& rpcpassword);
 
     void doAutoConnect(bool tryEzcashdStart = true);
     void doManualConnect();
@@ -95,8 +162,19 @@ public:
     std::shared_ptr<ConnectionConfig>   config;
     MainWindow*                         main;
 
+    RPCScheduler*                       scheduler;
+    RPCMetrics*                         metrics;
+
+    // endpoints[0] is the primary, which gets every call that isn't read-only.
+    // request always points to the primary's request.
+    QList<RPCEndpoint*>                 endpoints;
+    void addEndpoint(const QString& name, QNetworkRequest* r);
+
     void shutdown();
 
+    void sendRPC(const QString& method, const QByteArray& body, RPCPriority priority, 
+                    const std::function<void(QNetworkReply*)>& onFinished, QTimer* watchdog = nullptr);
+
     void doRPCSafe(const json& payload, const std::function<void(json)>& cb, 
                        const std::function<void(QNetworkReply*, const json&)>& ne);
     void doRPCWithDefaultErrorHandling(const json& payload, const std::function<void(json)>& cb);
@@ -105,81 +183,192 @@ public:
                        const std::function<void(QNetworkReply*, const json&)>& ne);
 
     void showTxError(const QString& error);
+    void reportError(const QString& method, QNetworkReply* reply, const json& parsed);
+
+    void doRPCSafeRaw(const json& payload, const std::function<void(const QByteArray&)>& cb, 
+                       const std::function<void(QNetworkReply*, const json&)>& ne);
+    void doRPCRawWithDefaultErrorHandling(const json& payload, const std::function<void(const QByteArray&)>& cb);
+    void doRPCDirectRaw(const json& payload, const std::function<void(const QByteArray&)>& cb, 
+                       const std::function<void(QNetworkReply*, const json&)>& ne);
+
+    // The same, for a request body that has already been serialized
+    void doRPCSafeRaw(const QString& method, const QByteArray& body, const std::function<void(const QByteArray&)>& cb, 
+                       const std::function<void(QNetworkReply*, const json&)>& ne);
+    void doRPCRawWithDefaultErrorHandling(const QString& method, const QByteArray& body, 
+                       const std::function<void(const QByteArray&)>& cb);
+    void doRPCDirectRaw(const QString& method, const QByteArray& body, const std::function<void(const QByteArray&)>& cb, 
+                       const std::function<void(QNetworkReply*, const json&)>& ne);
+
+    void doRPCBatchArray(const json& batch, const std::function<void(const QByteArray&)>& cb,
+                            const std::function<void(QNetworkReply*)>& ne,
+                            RPCPriority priority = RPCPriority::Background, QTimer* watchdog = nullptr);
+    static QMap<int, json> decodeBatchReply(const QByteArray& body);
+
+    void whenNotRescanning(const std::function<void(void)>& fn);
+
+    static bool isReadOnlyMethod(const QString& method);
+    static bool isIdempotent(const QString& method);
+    static bool isCancellable(const QString& method);
+
+    void newRefreshGeneration();
+    int  getRefreshGeneration() { return refreshGeneration; }
+
+    // Calls made while fn runs, and the calls made from their callbacks, belong to the given 
+    // refresh generation. 0 means they don't belong to a refresh, and are never dropped.
+    void withGeneration(int generation, const std::function<void(void)>& fn);
+    int  issuingGeneration() { return issuing; }
+    bool isStale(int generation) { return generation != 0 && generation != refreshGeneration; }
+    bool isRescanning() { return rescanning; }
+
+    // Hand a reply body back to the buffer pool. A callback that passes the body on to a worker
+    // calls this once the worker is done with it, since the pool only takes buffers nobody else holds.
+    void recycleBuffer(QByteArray& buf);
 
     // Batch method. Note: Because of the template, it has to be in the header file. 
     template<class T>
     void doBatchRPC(const QList<T>& payloads,
                      std::function<json(T)> payloadGenerator,
-                     std::function<void(QMap<T, json>*)> cb) {    
-        auto responses = new QMap<T, json>(); // zAddr -> list of responses for each call. 
+                     std::function<void(QMap<T, json>*)> cb,
+                     std::function<void(void)> failed = nullptr) {
+        doBatchRPCDecoded<T, json>(payloads, payloadGenerator, &Connection::decodeBatchReply, json::object(), cb, failed);
+    }
+
+    // Batch method that turns each reply body into results with the given decoder instead of a json DOM.
+    // The decoder returns the results keyed by the id of each call. Items whose result is missing
+    // get the missing value. If failed is given, it is called instead of cb when a chunk of the batch
+    // was never answered, so callers can tell a lost chunk from calls that returned errors.
+    template<class T, class R>
+    void doBatchRPCDecoded(const QList<T>& payloads,
+                     std::function<json(T)> payloadGenerator,
+                     std::function<QMap<int, R>(const QByteArray&)> decoder,
+                     R missing,
+                     std::function<void(QMap<T, R>*)> cb,
+                     std::function<void(void)> failed = nullptr) {    
         int totalSize = payloads.size();
-        if (totalSize == 0)
+        if (totalSize == 0) {
+            cb(new QMap<T, R>());
             return;
+        }
+
+        auto responses = new QMap<T, R>(); // zAddr -> list of responses for each call. 
+        auto answered  = std::make_shared<QSet<int>>();
+        auto decoded   = std::make_shared<WorkerPool::Queue>();
+        int  generation = issuing;
+
+        int chunkSize = batchChunkSize();
+
+        int numChunks = (totalSize + chunkSize - 1) / chunkSize;
 
-        // Keep track of all pending method calls, so as to prevent 
-        // any overlapping calls
-        static QMap<QString, bool> inProgress;
-
-        QString method = QString::fromStdString(payloadGenerator(payloads[0])["method"]);
-        //if (inProgress.value(method, false)) {
-        //    qDebug() << "In progress batch, skipping";
-        //    return;
-        //}
-
-        for (auto item: payloads) {
-            json payload = payloadGenerator(item);
-            inProgress[method] = true;
-            
-            QNetworkReply *reply = restclient->post(*request, QByteArray::fromStdString(payload.dump()));
-
-            QObject::connect(reply, &QNetworkReply::finished, [=] {
-                reply->deleteLater();
-                if (shutdownInProgress) {
-                    // Ignoring callback because shutdown in progress
+        auto job = std::make_shared<BatchJob>();
+        job->method    = QString::fromStdString(payloadGenerator(payloads[0])["method"]);
+        job->numChunks = numChunks;
+
+        // Chunks are only built when they are sent. Every call gets its index in the payloads list 
+        // as the id, so the results can be matched back to the items.
+        job->buildChunk = [=] (int chunk) {
+            json batch = json::array();
+            for (int i = chunk * chunkSize; i < std::min((chunk + 1) * chunkSize, totalSize); i++) {
+                json payload = payloadGenerator(payloads[i]);
+                payload["id"] = i;
+                batch.push_back(payload);
+            }
+            return batch;
+        };
+
+        // Chunks are decoded on a worker, and their results are filed away on the GUI thread
+        job->chunkAnswered = [=] (int chunk, const QByteArray& body) {
+            auto buffer = std::make_shared<QByteArray>(body);
+            WorkerPool::run<QMap<int, R>>(decoded, [=] () { return decoder(*buffer); }, [=] (const QMap<int, R>& results) {
+                recycleBuffer(*buffer);
+
+                for (int i = chunk * chunkSize; i < std::min((chunk + 1) * chunkSize, totalSize); i++) {
+                    // Missing or failed calls
+                    (*responses)[payloads[i]] = results.value(i, missing);
+                }
+                answered->insert(chunk);
+            });
+        };
+
+        job->complete = [=] (bool dropped) {
+            // Chunks that are still being decoded are filed away first
+            WorkerPool::after(decoded, [=] () {
+                // A newer refresh has started, and the chunks of this batch were dropped
+                if (dropped) {
+                    delete responses;
                     return;
                 }
-                
-                auto all = reply->readAll();            
-                auto parsed = json::parse(all.toStdString(), nullptr, false);
-
-                if (reply->error() != QNetworkReply::NoError) {            
-                    qDebug() << QString::fromStdString(parsed.dump());
-                    qDebug() << reply->errorString();
-
-                    (*responses)[item] = json::object();    // Empty object
-                } else {
-                    if (parsed.is_discarded()) {
-                        (*responses)[item] = json::object();    // Empty object
-                    } else {
-                        (*responses)[item] = parsed["result"];
-                    }
+
+                if (failed && answered->size() < numChunks) {
+                    delete responses;
+                    withGeneration(generation, [&] () { failed(); });
+                    return;
                 }
-            });
-        }
 
-        auto waitTimer = new QTimer(main);
-        QObject::connect(waitTimer, &QTimer::timeout, [=]() {
-            if (shutdownInProgress) {
-                waitTimer->stop();
-                waitTimer->deleteLater();  
-                return;
-            }
+                // Items whose reply never arrived
+                for (const T& item : payloads) {
+                    if (!responses->contains(item))
+                        (*responses)[item] = missing;
+                }
 
-            // If all responses have arrived, return
-            if (responses->size() == totalSize) {
-                waitTimer->stop();
-                
-                cb(responses);
-                inProgress[method] = false;
+                withGeneration(generation, [&] () { cb(responses); });
+            });
+        };
 
-                waitTimer->deleteLater();            
-            }
-        });
-        waitTimer->start(100);    
+        runBatch(job);
     }
 
 private:
+    int  batchChunkSize();
+    void runBatch(std::shared_ptr<BatchJob> job);
+    void pumpBatch(std::shared_ptr<BatchJob> job);
+    void finishBatch(std::shared_ptr<BatchJob> job);
+    static bool isWorkQueueFull(QNetworkReply* reply);
+
+    bool        shouldRetry(const OutgoingRPC& rpc, QNetworkReply* reply, bool unreachable);
+    static int  retryDelay(int attempts);
+
+    void         post(std::shared_ptr<OutgoingRPC> rpc, RPCEndpoint* endpoint);
+    RPCEndpoint* pickEndpoint(const QString& method);
+    void         endpointAnswered(RPCEndpoint* endpoint, qint64 elapsedMs);
+    bool         endpointFailed(RPCEndpoint* endpoint, const QString& method);
+    bool         failOver();
+    static bool  isPinnedToPrimary(const QString& method);
+
+    QByteArray readReply(QNetworkReply* reply);
+
+    void readShared(const QString& method, const json& params, const QByteArray& body, const PendingRead& waiter);
+    void sendSharedRead(const QString& key, int id);
+    void deliverSharedRead(const QString& key, int id, QNetworkReply* reply);
+
+    void probeRescanStatus();
+    void releaseParkedRPCs();
+
     bool shutdownInProgress = false;    
+
+    // Cached result of the last getrescaninfo probe, shared by all callers
+    bool                                rescanning          = false;
+    bool                                rescanInfoSupported = true;
+    bool                                rescanProbeInFlight = false;
+    QElapsedTimer                       rescanCheckedAt;
+    QList<std::function<void(void)>>    parkedRPCs;
+
+    // When the last call that changes the wallet was sent or answered. Reads go to the primary for
+    // a while after it, since a replica may not have seen the change yet.
+    QElapsedTimer                       walletChangedAt;
+
+    // Identical read-only calls that are in flight, keyed by method and params
+    QHash<QString, InFlightRead>        inFlightReads;
+    int                                 nextReadId          = 0;
+
+    // Calls made for a refresh are tagged with the generation they were made in
+    int                                 refreshGeneration   = 0;
+    int                                 issuing             = 0;
+    QHash<QNetworkReply*, int>          liveReplies;
+
+    // Receive buffers reused across replies
+    static const int                    maxPooledBuffers    = 8;
+    static const int                    maxPooledBufferSize = 16 * 1024 * 1024;
+    QList<QByteArray>                   bufferPool;
 };
 
 #endif
@@ -6,6 +6,8 @@
 #include "turnstile.h"
 #include "version.h"
 #include "rescanprogress.h"
+#include "rpcdecoder.h"
+#include "workerpool.h"
 
 using json = nlohmann::json;
 
@@ -25,6 +27,10 @@ Controller::Controller(MainWindow* main) {
     // Setup transactions table model
     transactionsTableModel = new TxTableModel(ui->transactionsTable);
     main->ui->transactionsTable->setModel(transactionsTableModel);
+
+    // Setup the RPC statistics table in the ycashd tab
+    rpcMetricsTableModel = new RPCMetricsTableModel(ui->rpcMetricsTable);
+    main->ui->rpcMetricsTable->setModel(rpcMetricsTableModel);
     
     // Set up timer to refresh Price
     priceTimer = new QTimer(main);
@@ -38,9 +44,47 @@ Controller::Controller(MainWindow* main) {
     timer = new QTimer(main);
     QObject::connect(timer, &QTimer::timeout, [=]() {
         refresh();
+        updateRefreshInterval();
+
+        // Nobody can see the table while the window is hidden
+        if (!Settings::getInstance()->isHeadless() && main->isVisible() && !main->isMinimized())
+            rpcMetricsTableModel->refresh();
     });
     timer->start(Settings::updateSpeed);    
 
+    // Poll faster while the wallet is being used, and catch up straight away when it comes back
+    // from being hidden
+    QObject::connect(qApp, &QGuiApplication::applicationStateChanged, [=] (Qt::ApplicationState state) {
+        if (state != Qt::ApplicationActive) {
+            updateRefreshInterval();
+            return;
+        }
+
+        bool wasBackedOff = timer->interval() > Settings::updateSpeed;
+        scheduler.userActive();
+        updateRefreshInterval();
+
+        if (wasBackedOff && zrpc->haveConnection())
+            refresh();
+    });
+    QObject::connect(ui->tabWidget, &QTabWidget::currentChanged, [=] (int) {
+        scheduler.userActive();
+        updateRefreshInterval();
+    });
+
+    // Periodically write the RPC statistics to the log file
+    metricsTimer = new QTimer(main);
+    QObject::connect(metricsTimer, &QTimer::timeout, [=]() {
+        if (!zrpc->haveConnection())
+            return;
+
+        for (auto& line : getConnection()->metrics->summary()) {
+            this->main->logger->write(line);
+        }
+        this->main->logger->write(refreshEngine->summary());
+    });
+    metricsTimer->start(Settings::rpcMetricsLogSpeed);
+
     // Set up the timer to watch for tx status
     txTimer = new QTimer(main);
     QObject::connect(txTimer, &QTimer::timeout, [=]() {
@@ -57,14 +101,140 @@ Controller::Controller(MainWindow* main) {
 
     // Initialize the migration status to unavailable.
     this->migrationStatus.available = false;
+
+    refreshEngine = new RefreshEngine(main);
+    setupRefreshStages();
+
+    notifyListener = new NotifyListener(main);
+    setupNotifications();
+}
+
+/**
+ * Refresh as soon as ycashd tells us about a new block or wallet transaction. Once notifications
+ * are coming in, the refresh timer is only a slow fallback.
+ */
+void Controller::setupNotifications() {
+    auto fnNotified = [=] (bool force) {
+        scheduler.setNotifications(true);
+        updateRefreshInterval();
+
+        refresh(force);
+    };
+
+    QObject::connect(notifyListener, &NotifyListener::blockNotified, [=] (const QString&) {
+        fnNotified(false);
+    });
+
+    // A wallet transaction can come in without a new block, so refresh even if the block is the same
+    QObject::connect(notifyListener, &NotifyListener::walletNotified, [=] (const QString&) {
+        fnNotified(true);
+    });
+
+    notifyListener->listen();
+}
+
+/**
+ * Restart the refresh timer if the state of the wallet calls for a different interval
+ */
+void Controller::updateRefreshInterval() {
+    scheduler.setHidden(Settings::getInstance()->isHeadless() || !main->isVisible() || main->isMinimized());
+
+    int interval = scheduler.interval();
+    if (timer->interval() == interval)
+        return;
+
+    main->logger->write(QString("Refreshing every %1s (%2)").arg(interval / 1000).arg(scheduler.reason()));
+    timer->start(interval);
+}
+
+/**
+ * The stages of a refresh and the inputs each one needs. Stages without inputs all start at once.
+ */
+void Controller::setupRefreshStages() {
+    // Everything a stage sends is tagged with the refresh it is for, so that a newer refresh can
+    // drop it. Calls made outside the stages, like key exports, are never dropped.
+    auto fnAddStage = [=] (const QString& name, const QStringList& inputs, const RefreshEngine::StageFn& run) {
+        refreshEngine->addStage(name, inputs, [=] (auto done, auto failed) {
+            getConnection()->withGeneration(refreshEngine->generation(), [&] () { run(done, failed); });
+        });
+    };
+
+    fnAddStage("addresses", {}, [=] (auto done, auto failed) {
+        refreshAddressList(done, failed);
+    });
+
+    fnAddStage("balances", {}, [=] (auto done, auto failed) {
+        refreshBalances(done, failed);
+    });
+
+    fnAddStage("transactions", {}, [=] (auto done, auto failed) {
+        refreshTransactions(done, failed);
+    });
+
+    // Drops the cached txs that a reorg took out of the chain, before anything reads them
+    fnAddStage("txcache", {}, [=] (auto done, auto failed) {
+        zrpc->checkTxCache(done, failed);
+    });
+
+    fnAddStage("sentz", {"txcache"}, [=] (auto done, auto failed) {
+        refreshSentZTrans(done, failed);
+    });
+
+    // Needs the y-addresses fetched by the addresses stage, and the notes that changed, which the
+    // balances stage works out from the new UTXOs
+    fnAddStage("receivedz", {"addresses", "balances", "txcache"}, [=] (auto done, auto failed) {
+        refreshChangedReceivedZTrans(done, failed);
+    });
+
+    fnAddStage("migration", {}, [=] (auto done, auto failed) {
+        refreshMigration(done, failed);
+    });
+
+    QObject::connect(refreshEngine, &RefreshEngine::cycleComplete, [=] (int generation, qint64 elapsedMs) {
+        QStringList stages;
+        auto& times = refreshEngine->stageTimes();
+        for (auto it = times.constBegin(); it != times.constEnd(); it++) {
+            stages << it.key() % "=" % QString::number(it.value()) % "ms";
+        }
+
+        main->logger->write(QString("Refresh %1 took %2ms (%3)").arg(generation).arg(elapsedMs).arg(stages.join(" ")));
+        ui->lblRefreshStats->setText(refreshEngine->summary());
+
+        runDeferredRefresh();
+    });
+
+    // Whatever the failed stage ran into has been reported, so just try again on the next refresh
+    QObject::connect(refreshEngine, &RefreshEngine::cycleFailed, [=] (int generation, const QString& stage) {
+        main->logger->write(QString("Refresh %1 failed in %2").arg(generation).arg(stage));
+        ui->lblRefreshStats->setText(refreshEngine->summary());
+
+        runDeferredRefresh();
+    });
+
+    QObject::connect(refreshEngine, &RefreshEngine::cycleCancelled, [=] (int) {
+        runDeferredRefresh();
+    });
+}
+
+/**
+ * Run the refresh that was asked for while the last cycle was running, once it's out of the way
+ */
+void Controller::runDeferredRefresh() {
+    bool force;
+    if (!refreshEngine->takeDeferred(&force))
+        return;
+
+    QTimer::singleShot(0, main, [=] () { refresh(force); });
 }
 
 Controller::~Controller() {
     delete timer;
     delete txTimer;
+    delete metricsTimer;
 
     delete transactionsTableModel;
     delete balancesTableModel;
+    delete rpcMetricsTableModel;
 
     delete model;
     delete zrpc;
@@ -87,6 +257,7 @@ void Controller::setConnection(Connection* c) {
     if (c == nullptr) return;
 
     this->zrpc->setConnection(c);
+    rpcMetricsTableModel->setMetrics(c->metrics);
 
     ui->statusBar->showMessage("Ready!");
 
@@ -155,6 +326,9 @@ void Controller::noConnection() {
     balancesTableModel->setNewData(emptyBalances, emptyOutputs);
 
     // Clear Transactions table.
+    receivedZHistory.clear();
+    receivedZFullHeight = -1;
+
     QList<TransactionItem> emptyTxs;
     transactionsTableModel->addTData(emptyTxs);
     transactionsTableModel->addZRecvData(emptyTxs);
@@ -175,28 +349,106 @@ void Controller::noConnection() {
     ui->inputsCombo->clear();
 }
 
-// Refresh received z txs by calling z_listreceivedbyaddress/gettransaction
-void Controller::refreshReceivedZTrans(QList<QString> zaddrs) {
-    if (!zrpc->haveConnection()) 
-        return noConnection();
+// Refresh received z txs by calling z_listreceivedbyaddress/gettransaction for the given 
+// addresses. The other addresses keep the txs that were fetched for them earlier.
+void Controller::refreshReceivedZTrans(QList<QString> zaddrs, const StageCallback& done, const StageCallback& failed) {
+    if (!zrpc->haveConnection()) {
+        noConnection();
+        if (failed)
+            failed();
+        return;
+    }
 
     // We'll only refresh the received Z txs if settings allows us.
     if (!Settings::getInstance()->getSaveZtxs()) {
+        receivedZHistory.clear();
+        receivedZFullHeight = -1;
+
         QList<TransactionItem> emptylist;
         transactionsTableModel->addZRecvData(emptylist);
+        if (done)
+            done();
+        return;
+    }
+
+    if (zaddrs.isEmpty()) {
+        showReceivedZTrans();
+        if (done)
+            done();
         return;
     }
         
-    zrpc->fetchReceivedZTrans(zaddrs, 
+    int height = refreshHeight;
+    zrpc->fetchReceivedZTrans(zaddrs, height,
     [=] (QString addr) {
         model->markAddressUsed(addr);
     },
     [=] (QList<TransactionItem> txdata) {
-        transactionsTableModel->addZRecvData(txdata);
-    }
+        for (auto& addr : zaddrs) {
+            receivedZHistory[addr].clear();
+        }
+        for (auto& tx : txdata) {
+            receivedZHistory[tx.address].push_back(tx);
+        }
+
+        showReceivedZTrans();
+        if (done)
+            done();
+    },
+    failed
     );
 } 
 
+/**
+ * Fetch the received txs of only the y-addresses whose notes changed since the last refresh. Every
+ * receivedZResyncBlocks all of them are fetched again, which also catches notes that were received 
+ * and spent between two refreshes, and so never showed up in the UTXOs.
+ */
+void Controller::refreshChangedReceivedZTrans(const StageCallback& done, const StageCallback& failed) {
+    auto zaddrs = model->getAllZAddresses();
+    int  height = refreshHeight;
+
+    // A reorg could have changed anything
+    bool full = receivedZFullHeight < 0 || height < receivedZFullHeight ||
+                height - receivedZFullHeight >= Settings::receivedZResyncBlocks;
+
+    // Forget the addresses that have gone away
+    for (auto& addr : receivedZHistory.keys()) {
+        if (!zaddrs.contains(addr))
+            receivedZHistory.remove(addr);
+    }
+
+    QList<QString> changed;
+    for (auto& addr : zaddrs) {
+        if (full || changedAddresses.contains(addr) || !receivedZHistory.contains(addr))
+            changed.push_back(addr);
+    }
+
+    auto fetched = changedAddresses;
+    refreshReceivedZTrans(changed, [=] () {
+        // Anything that changed while these were being fetched is left for the next refresh
+        changedAddresses.subtract(fetched);
+        if (full)
+            receivedZFullHeight = height;
+
+        if (done)
+            done();
+    }, failed);
+}
+
+/**
+ * Show the received txs of all y-addresses. The txs table counts the confirmations of the ones
+ * that were fetched a few blocks ago from the blocks they were mined in.
+ */
+void Controller::showReceivedZTrans() {
+    QList<TransactionItem> txdata;
+    for (auto& txs : receivedZHistory) {
+        txdata.append(txs);
+    }
+
+    transactionsTableModel->addZRecvData(txdata);
+}
+
 void Controller::refreshRescanStatus() {
     zrpc->refreshRescanStatus([=] (const json& reply) {
         if (reply["rescanning"].get<json::boolean_t>()) {
@@ -228,6 +480,9 @@ void Controller::closeRefreshStatusIfAlive() {
 
             // Update the status bar
             ui->statusBar->showMessage(QObject::tr("Rescan finished"));
+
+            // The rescan may have found txs in blocks from before the history's anchor
+            zrpc->resetTransactionHistory();
         }
 
         progressDeleteLock.unlock();
@@ -240,6 +495,11 @@ void Controller::refresh(bool force) {
     if (!zrpc->haveConnection()) 
         return noConnection();
 
+    // While ycashd is rescanning, the calls from the previous refresh are parked in the 
+    // connection and will run when the rescan is done, so don't pile up more of them.
+    if (getConnection()->isRescanning())
+        return;
+
     getInfoThenRefresh(force);
 }
 
@@ -250,11 +510,11 @@ void Controller::getInfoThenRefresh(bool force) {
 
     static bool prevCallSucceeded = false;
 
-    zrpc->fetchInfo([=] (const json& reply) {   
+    zrpc->fetchInfo([=] (const NodeInfo& reply) {   
         prevCallSucceeded = true;
         // Testnet?
-        if (!reply["testnet"].is_null()) {
-            Settings::getInstance()->setTestnet(reply["testnet"].get<json::boolean_t>());
+        if (reply.hasTestnet) {
+            Settings::getInstance()->setTestnet(reply.testnet);
         };
 
         // Connected, so display checkmark.
@@ -262,21 +522,30 @@ void Controller::getInfoThenRefresh(bool force) {
         main->statusIcon->setPixmap(i.pixmap(16, 16));
 
         static int    lastBlock = 0;
-        int curBlock  = reply["blocks"].get<json::number_integer_t>();
-        int version = reply["version"].get<json::number_integer_t>();
+        int curBlock  = reply.blocks;
+        int version = reply.version;
         Settings::getInstance()->setZcashdVersion(version);
 
-        if ( force || (curBlock != lastBlock) ) {
+        bool newBlock = curBlock != lastBlock;
+        if (!newBlock && force && refreshEngine->isRunning()) {
+            // Don't start another cycle on top of one that is still running for this block, which
+            // would only add to the load of a ycashd that is already slow. Refresh once more when
+            // it's done instead. A new block does cancel the running cycle, since it's out of date.
+            refreshEngine->defer(force);
+        } else if (force || newBlock) {
             // Something changed, so refresh everything.
             lastBlock = curBlock;
 
-            refreshBalances();        
-            refreshAddresses();     // This calls refreshZSentTransactions() and refreshReceivedZTrans()
-            refreshTransactions();
-            refreshMigration();     // Sapling turnstile migration status.
+            // The confirmations of everything that's mined just move on, without asking ycashd
+            transactionsTableModel->setTipHeight(curBlock);
+
+            // Whatever the previous refresh still has outstanding is out of date now
+            refreshHeight = curBlock;
+            getConnection()->newRefreshGeneration();
+            refreshEngine->start(getConnection()->getRefreshGeneration());
         }
 
-        int connections = reply["connections"].get<json::number_integer_t>();
+        int connections = reply.connections;
         Settings::getInstance()->setPeers(connections);
 
         if (connections == 0) {
@@ -294,19 +563,19 @@ void Controller::getInfoThenRefresh(bool force) {
         } 
 
         // Call to see if the blockchain is syncing. 
-        zrpc->fetchBlockchainInfo([=](const json& reply) {
-            auto progress    = reply["verificationprogress"].get<double>();
+        zrpc->fetchBlockchainInfo([=](const BlockchainInfo& reply) {
+            auto progress    = reply.verificationProgress;
             bool isSyncing   = progress < 0.9999; // 99.99%
-            int  blockNumber = reply["blocks"].get<json::number_unsigned_t>();
+            int  blockNumber = reply.blocks;
 
-            int estimatedheight = 0;
-            if (reply.find("estimatedheight") != reply.end()) {
-                estimatedheight = reply["estimatedheight"].get<json::number_unsigned_t>();
-            }
+            int estimatedheight = reply.estimatedHeight;
 
             Settings::getInstance()->setSyncing(isSyncing);
             Settings::getInstance()->setBlockNumber(blockNumber);
 
+            scheduler.setSyncing(isSyncing);
+            updateRefreshInterval();
+
             // Update zcashd tab if it exists
             if (ezcashd) {
                 if (isSyncing) {
@@ -354,6 +623,8 @@ void Controller::getInfoThenRefresh(bool force) {
                 tooltip = QObject::tr("ycashd has no peer connections");
             }
             tooltip = tooltip % "(v " % QString::number(Settings::getInstance()->getZcashdVersion()) % ")";
+            tooltip = tooltip % "\n" % QObject::tr("Refreshing every %1 s (%2)")
+                                            .arg(timer->interval() / 1000).arg(scheduler.reason());
 
             if (!zecPrice.isEmpty()) {
                 tooltip = "1 " % Settings::getTokenName() % " = " % zecPrice % "\n" % tooltip;
@@ -362,16 +633,20 @@ void Controller::getInfoThenRefresh(bool force) {
             main->statusIcon->setToolTip(tooltip);
         });
 
-    }, [=](QNetworkReply* reply, const json&) {
+    }, [=](QNetworkReply* reply, const json& parsed) {
         // zcashd has probably disappeared.
         this->noConnection();
 
+        // A reply that couldn't be decoded has no network error, only a message
+        QString error = reply != nullptr ? reply->errorString() 
+                                         : QString::fromStdString(parsed["error"]["message"].get<json::string_t>());
+
         // Prevent multiple dialog boxes, because these are called async
         static bool shown = false;
         if (!shown && prevCallSucceeded) { // show error only first time
             shown = true;
             QMessageBox::critical(main, QObject::tr("Connection Error"), QObject::tr("There was an error connecting to ycashd. The error was") + ": \n\n"
-                + reply->errorString(), QMessageBox::StandardButton::Ok);
+                + error, QMessageBox::StandardButton::Ok);
             shown = false;
         }
 
@@ -380,35 +655,47 @@ void Controller::getInfoThenRefresh(bool force) {
 }
 
 void Controller::refreshAddresses() {
-    if (!zrpc->haveConnection()) 
-        return noConnection();
-    
-    auto newzaddresses = new QList<QString>();
-
-    zrpc->fetchZAddresses([=] (json reply) {
-        for (auto& it : reply.get<json::array_t>()) {   
-            auto addr = QString::fromStdString(it.get<json::string_t>());
-            newzaddresses->push_back(addr);
-        }
-
-        model->replaceZaddresses(newzaddresses);
-
+    refreshAddressList([=] () {
         // Refresh the sent and received txs from all these y-addresses
         refreshSentZTrans();
         refreshReceivedZTrans(model->getAllZAddresses());
     });
+}
+
+void Controller::refreshAddressList(const StageCallback& done, const StageCallback& failed) {
+    if (!zrpc->haveConnection()) {
+        noConnection();
+        if (failed)
+            failed();
+        return;
+    }
+    
+    // Both lists have to be in before the addresses are done
+    auto remaining = std::make_shared<int>(2);
+    auto fnFetched = [=] () {
+        if (--(*remaining) == 0 && done)
+            done();
+    };
+
+    auto newzaddresses = new QList<QString>();
+    zrpc->fetchZAddresses([=] (const QList<QString>& reply) {
+        newzaddresses->append(reply);
+
+        model->replaceZaddresses(newzaddresses);
+        fnFetched();
+    }, failed);
 
     
     auto newtaddresses = new QList<QString>();
-    zrpc->fetchTAddresses([=] (json reply) {
-        for (auto& it : reply.get<json::array_t>()) {   
-            auto addr = QString::fromStdString(it.get<json::string_t>());
+    zrpc->fetchTAddresses([=] (const QList<QString>& reply) {
+        for (auto& addr : reply) {   
             if (Settings::isTAddress(addr))
                 newtaddresses->push_back(addr);
         }
 
         model->replaceTaddresses(newtaddresses);
-    });
+        fnFetched();
+    }, failed);
 }
 
 // Function to create the data model and update the views, used below.
@@ -422,34 +709,67 @@ void Controller::updateUI(bool anyUnconfirmed) {
     main->updateFromCombo();
 };
 
-// Function to process reply of the listunspent and z_listunspent API calls, used below.
-bool Controller::processUnspent(const json& reply, QMap<QString, double>* balancesMap, QList<UnspentOutput>* newUtxos) {
-    bool anyUnconfirmed = false;
-    for (auto& it : reply.get<json::array_t>()) {
-        QString qsAddr = QString::fromStdString(it["address"]);
-        auto confirmations = it["confirmations"].get<json::number_unsigned_t>();
-        if (confirmations == 0) {
-            anyUnconfirmed = true;
-        }
+// Function to process the combined replies of the listunspent and z_listunspent API calls, used below.
+void Controller::processUnspent(const UnspentList& unspent, const QSet<QString>& changed) {
+    // Create a new UTXO list. It will be replacing the existing list.
+    auto newUtxos    = new QList<UnspentOutput>(unspent.utxos);
+    auto newBalances = new QMap<QString, double>();
+    for (auto it = unspent.balances.constBegin(); it != unspent.balances.constEnd(); it++) {
+        (*newBalances)[it.key()] = it.value().total();
+    }
 
-        newUtxos->push_back(
-            UnspentOutput{ qsAddr, QString::fromStdString(it["txid"]),
-                            Settings::getDecimalString(it["amount"].get<json::number_float_t>()),
-                            (int)confirmations, it["spendable"].get<json::boolean_t>() });
+    // Remember which addresses have to have their received txs fetched again
+    changedAddresses.unite(changed);
+
+    // Swap out the balances and UTXOs
+    model->replaceBalances(newBalances);
+    model->replaceUTXOs(newUtxos);
+
+    auto balT      = unspent.transparent.total();
+    auto balZ      = unspent.shielded().total();
+    auto balTotal  = unspent.total().total();
+
+    ui->balSheilded   ->setText(Settings::getZECDisplayFormat(balZ));
+    ui->balTransparent->setText(Settings::getZECDisplayFormat(balT));
+    ui->balTotal      ->setText(Settings::getZECDisplayFormat(balTotal));
+    if (Settings::getInstance()->getZECPrice() > 0)
+        ui->balTotalUsd   ->setText(Settings::getUSDFromZecAmount(balTotal));
+
+    // Show how much of it is still unconfirmed
+    auto fnTooltip = [=] (const Balance& bal) {
+        QString tooltip = Settings::getZECDisplayFormat(bal.total());
+        if (bal.unconfirmed != 0)
+            tooltip = tooltip % "\n" % QObject::tr("%1 unconfirmed").arg(Settings::getZECDisplayFormat(bal.unconfirmed));
+        return tooltip;
+    };
 
-        (*balancesMap)[qsAddr] = (*balancesMap)[qsAddr] + it["amount"].get<json::number_float_t>();
-    }
-    return anyUnconfirmed;
+    ui->balSheilded   ->setToolTip(fnTooltip(unspent.shielded()));
+    ui->balTransparent->setToolTip(fnTooltip(unspent.transparent));
+    ui->balTotal      ->setToolTip(fnTooltip(unspent.total()));
+    if (Settings::getInstance()->getZECPrice() > 0)
+        ui->balTotalUsd   ->setToolTip(Settings::getUSDFromZecAmount(balTotal));
+
+    updateUI(unspent.anyUnconfirmed);
 };
 
 /**
  * Refresh the turnstile migration status
  */
-void Controller::refreshMigration() {
+void Controller::refreshMigration(const StageCallback& done, const StageCallback& failed) {
+    if (!zrpc->haveConnection()) {
+        noConnection();
+        if (failed)
+            failed();
+        return;
+    }
+
     // Turnstile migration is only supported in zcashd v2.0.5 and above
     if (Settings::getInstance()->getZcashdVersion() < 2000552 ||
-        !Settings::getInstance()->isSaplingActive())    // Only if sapling is active
+        !Settings::getInstance()->isSaplingActive()) {  // Only if sapling is active
+        if (done)
+            done();
         return;
+    }
 
     zrpc->fetchMigrationStatus([=](json reply) {
         this->migrationStatus.available = true;
@@ -463,94 +783,83 @@ void Controller::refreshMigration() {
             ids.push_back(QString::fromStdString(it.get<json::string_t>()));
         }
         this->migrationStatus.txids = ids;
-    });
-}
-
-void Controller::refreshBalances() {    
-    if (!zrpc->haveConnection()) 
-        return noConnection();
-
-    // 1. Get the Balances
-    zrpc->fetchBalance([=] (json reply) {    
-        auto balT      = QString::fromStdString(reply["transparent"]).toDouble();
-        auto balZ      = QString::fromStdString(reply["private"]).toDouble();
-        auto balTotal  = QString::fromStdString(reply["total"]).toDouble();
-
-        ui->balSheilded   ->setText(Settings::getZECDisplayFormat(balZ));
-        ui->balTransparent->setText(Settings::getZECDisplayFormat(balT));
-        ui->balTotal      ->setText(Settings::getZECDisplayFormat(balTotal));
-        if (Settings::getInstance()->getZECPrice() > 0)
-            ui->balTotalUsd   ->setText(Settings::getUSDFromZecAmount(balTotal));
 
+        if (done)
+            done();
+    }, failed);
+}
 
-        ui->balSheilded   ->setToolTip(Settings::getZECDisplayFormat(balZ));
-        ui->balTransparent->setToolTip(Settings::getZECDisplayFormat(balT));
-        ui->balTotal      ->setToolTip(Settings::getZECDisplayFormat(balTotal));
-        if (Settings::getInstance()->getZECPrice() > 0)
-            ui->balTotalUsd   ->setToolTip(Settings::getUSDFromZecAmount(balTotal));
-    });
-
-    // 2. Get the UTXOs
-    // First, create a new UTXO list. It will be replacing the existing list when everything is processed.
-    auto newUtxos = new QList<UnspentOutput>();
-    auto newBalances = new QMap<QString, double>();
-
-    // Call the Transparent and Z unspent APIs serially and then, once they're done, update the UI
-    zrpc->fetchTransparentUnspent([=] (json reply) {
-        auto anyTUnconfirmed = processUnspent(reply, newBalances, newUtxos);
+void Controller::refreshBalances(const StageCallback& done, const StageCallback& failed) {    
+    if (!zrpc->haveConnection()) {
+        noConnection();
+        if (failed)
+            failed();
+        return;
+    }
 
-        zrpc->fetchZUnspent([=] (json reply) {
-            auto anyZUnconfirmed = processUnspent(reply, newBalances, newUtxos);
+    // The transparent and shielded UTXOs are fetched at the same time. The totals are summed up 
+    // from them while they're decoded, so z_gettotalbalance isn't needed.
+    auto unspent   = std::make_shared<UnspentList>();
+    auto remaining = std::make_shared<int>(2);
+    auto fnFetched = [=] (const UnspentList& reply) {
+        unspent->merge(reply);
+        if (--(*remaining) > 0)
+            return;
 
-            // Swap out the balances and UTXOs
-            model->replaceBalances(newBalances);
-            model->replaceUTXOs(newUtxos);
+        // Compare them to the UTXOs we have on a worker. The lists are implicitly shared, so
+        // the worker reads them without anything being copied or locked.
+        auto before     = model->getUTXOs();
+        int  generation = getConnection()->issuingGeneration();
+        WorkerPool::run<QSet<QString>>([=] () {
+            return DataModel::changedAddresses(before, unspent->utxos);
+        }, [=] (const QSet<QString>& changed) {
+            // The UTXOs of a newer refresh may have been shown already
+            if (getConnection()->isStale(generation))
+                return;
 
-            updateUI(anyTUnconfirmed || anyZUnconfirmed);
+            processUnspent(*unspent, changed);
 
             main->balancesReady();
-        });        
-    });
-}
-
-void Controller::refreshTransactions() {    
-    if (!zrpc->haveConnection()) 
-        return noConnection();
-
-    zrpc->fetchTransactions([=] (json reply) {
-        QList<TransactionItem> txdata;
-
-        for (auto& it : reply.get<json::array_t>()) {  
-            double fee = 0;
-            if (!it["fee"].is_null()) {
-                fee = it["fee"].get<json::number_float_t>();
-            }
+            if (done)
+                done();
+        });
+    };
 
-            QString address = (it["address"].is_null() ? "" : QString::fromStdString(it["address"]));
+    zrpc->fetchTransparentUnspent(fnFetched, failed);
+    zrpc->fetchZUnspent(fnFetched, failed);
+}
 
-            TransactionItem tx{
-                QString::fromStdString(it["category"]),
-                (qint64)it["time"].get<json::number_unsigned_t>(),
-                address,
-                QString::fromStdString(it["txid"]),
-                it["amount"].get<json::number_float_t>() + fee,
-                static_cast<long>(it["confirmations"].get<json::number_unsigned_t>()),
-                "", "" };
+void Controller::refreshTransactions(const StageCallback& done, const StageCallback& failed) {    
+    if (!zrpc->haveConnection()) {
+        noConnection();
+        if (failed)
+            failed();
+        return;
+    }
 
-            txdata.push_back(tx);
-            if (!address.isEmpty())
-                model->markAddressUsed(address);
+    // The txs come back anchored at the blocks they were mined in
+    zrpc->fetchTransactions(refreshHeight, [=] (const QList<TransactionItem>& txdata) {
+        for (auto& tx : txdata) {
+            if (!tx.address.isEmpty())
+                model->markAddressUsed(tx.address);
         }
 
         // Update model data, which updates the table view
         transactionsTableModel->addTData(txdata);        
-    });
+
+        if (done)
+            done();
+    }, failed);
 }
 
 // Read sent Z transactions from the file.
-void Controller::refreshSentZTrans() {
-    if (!zrpc->haveConnection()) 
-        return noConnection();
+void Controller::refreshSentZTrans(const StageCallback& done, const StageCallback& failed) {
+    if (!zrpc->haveConnection()) {
+        noConnection();
+        if (failed)
+            failed();
+        return;
+    }
 
     auto sentZTxs = SentTxStore::readSentTxFile();
 
@@ -558,19 +867,28 @@ void Controller::refreshSentZTrans() {
     // This happens when you clear history.
     if (sentZTxs.isEmpty()) {
         transactionsTableModel->addZSentData(sentZTxs);
+        if (done)
+            done();
         return;
     }
 
     QList<QString> txids;
 
+    // Txs that were mined long enough ago have their block saved, and don't need looking up
     for (auto sentTx: sentZTxs) {
-        txids.push_back(sentTx.txid);
+        if (sentTx.height == 0)
+            txids.push_back(sentTx.txid);
     }
 
-    // Look up all the txids to get the confirmation count for them. 
-    zrpc->fetchReceivedTTrans(txids, sentZTxs, [=](auto newSentZTxs) {
+    // Look up the rest of the txids to get the confirmation count for them. 
+    zrpc->fetchReceivedTTrans(txids, sentZTxs, refreshHeight, [=](auto newSentZTxs, auto mined) {
+        // Once they're deep enough that a reorg won't move them, save the blocks they were mined in
+        SentTxStore::setMinedHeights(mined);
+
         transactionsTableModel->addZSentData(newSentZTxs);
-    });
+        if (done)
+            done();
+    }, failed);
 }
 
 void Controller::addNewTxToWatch(const QString& newOpid, WatchedTx wtx) {    
@@ -666,6 +984,9 @@ void Controller::watchTxStatus() {
             } else {
                 txTimer->start(Settings::quickUpdateSpeed);
             }
+
+            scheduler.setPendingOps(watchingOps.size());
+            updateRefreshInterval();
         }
 
         // If there is some op that we are watching, then show the loading bar, otherwise hide it
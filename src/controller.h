@@ -10,6 +10,9 @@
 #include "mainwindow.h"
 #include "zcashdrpc.h"
 #include "connection.h"
+#include "refreshengine.h"
+#include "notifylistener.h"
+#include "refreshscheduler.h"
 
 using json = nlohmann::json;
 
@@ -51,6 +54,8 @@ public:
     void checkForUpdate(bool silent = true);
     void refreshZECPrice();
 
+    void clearTxCache() { zrpc->clearTxCache(); }
+
     void executeStandardUITransaction(Tx tx); 
 
     void executeTransaction(Tx tx, 
@@ -78,12 +83,12 @@ public:
 
     void fetchZPrivKey(QString addr, const std::function<void(json)>& cb) { zrpc->fetchZPrivKey(addr, cb); }
     void fetchTPrivKey(QString addr, const std::function<void(json)>& cb) { zrpc->fetchTPrivKey(addr, cb); }
-    void fetchAllPrivKeys(const std::function<void(QList<QPair<QString, QString>>)> cb) { zrpc->fetchAllPrivKeys(cb); }
+    void fetchAllPrivKeys(const std::function<void(QList<QPair<QString, QString>>)> cb, const std::function<void(QStringList)>& failed) { zrpc->fetchAllPrivKeys(cb, failed); }
 
     void fetchZViewingKey(QString addr, const std::function<void(json)>& cb) { zrpc->fetchZViewingKey(addr, cb); }
     void fetchZIVK(QString addr, const std::function<void(json)>& cb) { zrpc->fetchZIVK(addr, cb); }
-    void fetchAllViewingKeys(const std::function<void(QList<QPair<QString, QString>>)> cb) { zrpc->fetchAllViewingKeys(cb); }
-    void fetchAllIVK(const std::function<void(QList<QPair<QString, QString>>)> cb) { zrpc->fetchAllIVK(cb); }
+    void fetchAllViewingKeys(const std::function<void(QList<QPair<QString, QString>>)> cb, const std::function<void(QStringList)>& failed) { zrpc->fetchAllViewingKeys(cb, failed); }
+    void fetchAllIVK(const std::function<void(QList<QPair<QString, QString>>)> cb, const std::function<void(QStringList)>& failed) { zrpc->fetchAllIVK(cb, failed); }
 
     void importZPrivKey(QString addr, bool rescan, int rescanHeight, const std::function<void(json)>& cb) { zrpc->importZPrivKey(addr, rescan, rescanHeight, cb); }
     void importTPrivKey(QString addr, bool rescan, int rescanHeight, const std::function<void(json)>& cb) { zrpc->importTPrivKey(addr, rescan, rescanHeight, cb); }
@@ -101,14 +106,25 @@ public:
     void  setMigrationStatus(bool status) { zrpc->setMigrationStatus(status); }
     
 private:
-    void refreshBalances();
-
-    void refreshTransactions();    
-    void refreshMigration();
-    void refreshSentZTrans();
-    void refreshReceivedZTrans(QList<QString> zaddresses);
-
-    bool processUnspent     (const json& reply, QMap<QString, double>* newBalances, QList<UnspentOutput>* newUtxos);
+    // The refresh stages. Each calls done, if given, once it has finished, or failed if it couldn't.
+    typedef std::function<void(void)> StageCallback;
+    void refreshAddressList(const StageCallback& done = nullptr, const StageCallback& failed = nullptr);
+    void refreshBalances(const StageCallback& done = nullptr, const StageCallback& failed = nullptr);
+
+    void refreshTransactions(const StageCallback& done = nullptr, const StageCallback& failed = nullptr);    
+    void refreshMigration(const StageCallback& done = nullptr, const StageCallback& failed = nullptr);
+    void refreshSentZTrans(const StageCallback& done = nullptr, const StageCallback& failed = nullptr);
+    void refreshReceivedZTrans(QList<QString> zaddresses, const StageCallback& done = nullptr, 
+                                const StageCallback& failed = nullptr);
+    void refreshChangedReceivedZTrans(const StageCallback& done = nullptr, const StageCallback& failed = nullptr);
+    void showReceivedZTrans();
+
+    void setupRefreshStages();
+    void runDeferredRefresh();
+    void setupNotifications();
+    void updateRefreshInterval();
+
+    void processUnspent     (const UnspentList& unspent, const QSet<QString>& changed);
     void updateUI           (bool anyUnconfirmed);
 
     void getInfoThenRefresh(bool force);
@@ -119,6 +135,7 @@ private:
 
     TxTableModel*               transactionsTableModel      = nullptr;
     BalancesTableModel*         balancesTableModel          = nullptr;
+    RPCMetricsTableModel*       rpcMetricsTableModel        = nullptr;
 
     DataModel*                  model;
     ZcashdRPC*                  zrpc;
@@ -126,6 +143,7 @@ private:
     QTimer*                     timer;
     QTimer*                     txTimer;
     QTimer*                     priceTimer;
+    QTimer*                     metricsTimer;
 
     Ui::MainWindow*             ui;
     MainWindow*                 main;
@@ -135,6 +153,26 @@ private:
 
     RescanProgress*             rescanProgress              = nullptr;
 
+    // Runs the refresh stages every time a new block comes in
+    RefreshEngine*              refreshEngine;
+
+    // Block and wallet notifications pushed by ycashd
+    NotifyListener*             notifyListener;
+
+    // Decides how often the refresh timer fires
+    RefreshScheduler            scheduler;
+
+    // The received y-txs of each y-address. Kept between refreshes, so only addresses whose notes
+    // changed have to be fetched again.
+    QMap<QString, QList<TransactionItem>> receivedZHistory;
+    int                         receivedZFullHeight         = -1;
+
+    // Addresses whose UTXOs changed since their received txs were last fetched
+    QSet<QString>               changedAddresses;
+
+    // The block height the current refresh is for
+    int                         refreshHeight               = 0;
+
     // Current balance in the UI. If this number updates, then refresh the UI
     QString                     currentBalance;
 };
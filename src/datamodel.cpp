@@ -57,6 +57,27 @@ void DataModel::replaceUTXOs(QList<UnspentOutput>* newutxos) {
     utxos = newutxos;
 }
 
+QSet<QString> DataModel::changedAddresses(const QList<UnspentOutput>& oldUtxos, const QList<UnspentOutput>& newUtxos) {
+    QHash<QString, const UnspentOutput*> before;
+    for (auto& u : oldUtxos) {
+        before[u.key()] = &u;
+    }
+
+    QSet<QString> changed;
+    for (auto& u : newUtxos) {
+        auto old = before.take(u.key());
+        if (old == nullptr || (old->confirmations == 0) != (u.confirmations == 0))
+            changed.insert(u.address);
+    }
+
+    // Whatever is left over has been spent
+    for (auto old : before) {
+        changed.insert(old->address);
+    }
+
+    return changed;
+}
+
 void DataModel::markAddressUsed(QString address) {
     QWriteLocker locker(lock);
 
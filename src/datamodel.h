@@ -5,11 +5,47 @@
 
 
 struct UnspentOutput {
+    enum Pool { Transparent, Sapling, Sprout };
+
     QString address;
     QString txid;
+    int     outindex;       // vout for transparent outputs, outindex for notes
     QString amount;    
     int     confirmations;
     bool    spendable;
+    Pool    pool            = Transparent;
+    int     jsindex         = -1;   // The JoinSplit a Sprout note is in
+
+    // Tells apart every output of a tx: the index alone repeats across pools and JoinSplits
+    QString key() const     { return txid % ":" % QString::number(pool) % ":" % QString::number(jsindex) % ":" % QString::number(outindex); }
+};
+
+// An amount split by whether the outputs that make it up are confirmed yet
+struct Balance {
+    double  confirmed       = 0;
+    double  unconfirmed     = 0;
+
+    double  total() const   { return confirmed + unconfirmed; }
+
+    void    add(double amount, bool isConfirmed) { (isConfirmed ? confirmed : unconfirmed) += amount; }
+    void    add(const Balance& other) { confirmed += other.confirmed; unconfirmed += other.unconfirmed; }
+};
+
+struct TransactionItem {
+    QString         type;
+    qint64          datetime;
+    QString         address;
+    QString         txid;
+    double          amount;
+    long            confirmations;
+    QString         fromAddr;
+    QString         memo;
+    int             height          = 0;    // The block it was mined in, or 0 if it isn't mined yet
+    int             vout            = -1;   // The output of a transparent entry, or -1 if not known
+    QString         blockhash;              // The block it was mined in, if ycashd reported it
+
+    // Anchor the tx to the block it was mined in, from its confirmations at the given tip
+    void            setMinedAt(int tip) { if (confirmations > 0) height = tip - static_cast<int>(confirmations) + 1; }
 };
 
 
@@ -23,6 +59,10 @@ public:
 
     void markAddressUsed(QString address);
 
+    // Addresses that gained or lost an output, or had one confirmed, between two lists of UTXOs.
+    // It doesn't touch the model, so it can run on a worker thread.
+    static QSet<QString> changedAddresses(const QList<UnspentOutput>& oldUtxos, const QList<UnspentOutput>& newUtxos);
+
     const QList<QString>             getAllZAddresses()     { QReadLocker locker(lock); return *zaddresses; }
     const QList<QString>             getAllTAddresses()     { QReadLocker locker(lock); return *taddresses; }
     const QList<UnspentOutput>       getUTXOs()             { QReadLocker locker(lock); return *utxos; }
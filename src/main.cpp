@@ -5,6 +5,7 @@
 #include "controller.h"
 #include "settings.h"
 #include "turnstile.h"
+#include "notifylistener.h"
 
 #include "version.h"
 
@@ -141,6 +142,13 @@ public:
     ~Application() {}
 
     int main(int argc, char *argv[]) {
+        // Started by ycashd's -blocknotify or -walletnotify. Hand the event to the running wallet 
+        // and exit, without bringing up any UI.
+        if (argc >= 3 && QString(argv[1]) == "--notify") {
+            QCoreApplication app(argc, argv);
+            return NotifyListener::send(QString(argv[2]), argc >= 4 ? QString(argv[3]) : QString()) ? 0 : 1;
+        }
+
         QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
         QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
 
@@ -164,6 +172,11 @@ public:
                                           "confFile");
         parser.addOption(confOption);
 
+        // Extra ycashd endpoints to spread read-only calls over. Can be given more than once.
+        QCommandLineOption replicaOption(QStringList() << "replica", "Also send read-only calls to the ycashd at [user:password@]host:port.",
+                                          "endpoint");
+        parser.addOption(replicaOption);
+
         // Positional argument will specify a ycash payment URI
         parser.addPositionalArgument("ycashURI", "An optional ycash URI to pay");
 
@@ -220,6 +233,10 @@ public:
             Settings::getInstance()->setUsingZcashConf(parser.value(confOption));
         }
 
+        for (auto& replica : parser.values(replicaOption)) {
+            Settings::getInstance()->addCommandLineReplica(replica);
+        }
+
         w = new MainWindow();
         w->setWindowTitle("YecWallet v" + QString(APP_VERSION));
 
@@ -104,6 +104,9 @@ MainWindow::MainWindow(QWidget *parent) :
     // Export transactions
     QObject::connect(ui->actionExport_transactions, &QAction::triggered, this, &MainWindow::exportTransactions);
 
+    // Save RPC statistics
+    QObject::connect(ui->actionSave_RPC_statistics, &QAction::triggered, this, &MainWindow::saveRPCStatistics);
+
     // Validate Address
     QObject::connect(ui->actionValidate_Address, &QAction::triggered, this, &MainWindow::validateAddress);
 
@@ -258,6 +261,7 @@ void MainWindow::setupSettingsModal() {
                 "Shielded y-Address transactions are stored locally in your wallet, outside ycashd. You may delete this saved information safely any time for your privacy.\nDo you want to delete the saved shielded transactions now?",
                 QMessageBox::Yes, QMessageBox::Cancel)) {
                     SentTxStore::deleteHistory();
+                    rpc->clearTxCache();
                     // Reload after the clear button so existing txs disappear
                     rpc->refresh(true);
             }
@@ -328,6 +332,25 @@ void MainWindow::setupSettingsModal() {
         settings.rpcuser->setText(conf.rpcuser);
         settings.rpcpassword->setText(conf.rpcpassword);
 
+        // Replicas can be used with either kind of connection
+        QString replicas = QSettings().value("connection/replicas").toStringList().join(", ");
+        settings.replicas->setText(replicas);
+        settings.chkPipelinedRPC->setChecked(Settings::getInstance()->getUsePipelinedRPC());
+
+        // RPC tuning
+        QIntValidator batchSizeValidator(1, 10000);
+        settings.rpcBatchSize->setValidator(&batchSizeValidator);
+        settings.rpcBatchSize->setText(QString::number(Settings::getInstance()->getRPCBatchSize()));
+
+        QIntValidator inFlightValidator(1, 64);
+        settings.maxRPCsInFlight->setValidator(&inFlightValidator);
+        settings.maxRPCsInFlight->setText(QString::number(Settings::getInstance()->getMaxRPCsInFlight()));
+
+        // Shallower than that, a reorg could still change the cached details
+        QIntValidator cacheDepthValidator(Settings::settledConfirmations, 100000);
+        settings.txCacheDepth->setValidator(&cacheDepthValidator);
+        settings.txCacheDepth->setText(QString::number(Settings::getInstance()->getTxCacheDepth()));
+
         // Connection tab by default
         settings.tabWidget->setCurrentIndex(0);
 
@@ -377,6 +400,47 @@ void MainWindow::setupSettingsModal() {
                     QMessageBox::Ok);
             }
 
+            // Read-only replicas
+            if (settings.replicas->text().trimmed() != replicas) {
+                QStringList endpoints;
+                for (auto& endpoint : settings.replicas->text().split(",", QString::SkipEmptyParts)) {
+                    if (!endpoint.trimmed().isEmpty())
+                        endpoints.append(endpoint.trimmed());
+                }
+                Settings::getInstance()->setReplicaEndpoints(endpoints);
+
+                if (!zcashConfLocation.isEmpty()) {
+                    QMessageBox::information(this, tr("Read-only replicas"), 
+                        tr("The new replicas will be used the next time YecWallet connects to ycashd."), 
+                        QMessageBox::Ok);
+                }
+            }
+
+            // RPC tuning. The batch size and the cache depth are used from the next refresh on.
+            if (settings.rpcBatchSize->hasAcceptableInput())
+                Settings::getInstance()->setRPCBatchSize(settings.rpcBatchSize->text().toInt());
+
+            if (settings.txCacheDepth->hasAcceptableInput())
+                Settings::getInstance()->setTxCacheDepth(settings.txCacheDepth->text().toInt());
+
+            if (settings.maxRPCsInFlight->hasAcceptableInput() && 
+                    settings.maxRPCsInFlight->text().toInt() != Settings::getInstance()->getMaxRPCsInFlight()) {
+                Settings::getInstance()->setMaxRPCsInFlight(settings.maxRPCsInFlight->text().toInt());
+
+                QMessageBox::information(this, tr("RPCs in flight"), 
+                    tr("The change will take effect the next time YecWallet connects to ycashd."), 
+                    QMessageBox::Ok);
+            }
+
+            // RPC transport
+            if (settings.chkPipelinedRPC->isChecked() != Settings::getInstance()->getUsePipelinedRPC()) {
+                Settings::getInstance()->setUsePipelinedRPC(settings.chkPipelinedRPC->isChecked());
+
+                QMessageBox::information(this, tr("Pipelined RPC connections"), 
+                    tr("The change will take effect the next time YecWallet connects to ycashd."), 
+                    QMessageBox::Ok);
+            }
+
             if (zcashConfLocation.isEmpty()) {
                 // Save settings
                 Settings::getInstance()->saveSettings(
@@ -908,6 +972,38 @@ void MainWindow::exportTransactions() {
     }
 } 
 
+/**
+ * Write the per-method RPC latency and throughput counters to a JSON file
+ */
+void MainWindow::saveRPCStatistics() {
+    if (rpc->getConnection() == nullptr) {
+        QMessageBox::information(this, tr("RPC statistics"), 
+            tr("Not connected to ycashd yet, so there are no statistics to save"), QMessageBox::Ok);
+        return;
+    }
+
+    QString fileName = "yecwallet-rpc-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+
+    QDir docsDir(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation));
+    QUrl pName = QUrl::fromLocalFile(docsDir.filePath(fileName));
+    QUrl jsonName = QFileDialog::getSaveFileUrl(this, 
+            tr("Save RPC statistics"), pName, "JSON file (*.json)");
+
+    if (jsonName.isEmpty())
+        return;
+
+    QFile file(jsonName.toLocalFile());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QMessageBox::critical(this, tr("Error"), 
+            tr("Error saving RPC statistics, file was not saved"), QMessageBox::Ok);
+        return;
+    }
+
+    auto stats = rpc->getConnection()->metrics->toJson();
+    file.write(QByteArray::fromStdString(stats.dump(4)));
+    file.close();
+}
+
 /**
  * Backup the wallet.dat file. This is kind of a hack, since it has to read from the filesystem rather than an RPC call
  * This might fail for various reasons - Remote ycashd, non-standard locations, custom params passed to ycashd, many others
@@ -1028,6 +1124,17 @@ void MainWindow::exportKeys(QString addr, bool viewkey) {
         pui.buttonBox->button(QDialogButtonBox::Save)->setEnabled(true);
     };
 
+    // Some of the keys couldn't be exported. The others aren't shown, so they can't be saved as if
+    // they were the whole backup.
+    auto fnKeysFailed = [=](QStringList addrs) {
+        if (! *(isDialogAlive.get()) ) return;
+
+        pui.privKeyTxt->setPlainText(tr("The export failed."));
+        QMessageBox::critical(this, tr("Export failed"),
+            tr("The keys for these addresses couldn't be exported, so the export was stopped. Please try again.") + 
+            "\n\n" + addrs.join("\n"), QMessageBox::Ok);
+    };
+
     auto fnAddKey = [=](json key) {
         QList<QPair<QString, QString>> singleAddrKey;
         singleAddrKey.push_back(QPair<QString, QString>(addr, QString::fromStdString(key.get<json::string_t>())));
@@ -1036,7 +1143,7 @@ void MainWindow::exportKeys(QString addr, bool viewkey) {
 
     if (viewkey) {
         if (allKeys) {
-            rpc->fetchAllViewingKeys(fnUpdateUIWithKeys);
+            rpc->fetchAllViewingKeys(fnUpdateUIWithKeys, fnKeysFailed);
         } else {
             if (Settings::getInstance()->isZAddress(addr)) {
                 rpc->fetchZViewingKey(addr, fnAddKey);
@@ -1046,7 +1153,7 @@ void MainWindow::exportKeys(QString addr, bool viewkey) {
         }
     } else {
         if (allKeys) {
-            rpc->fetchAllPrivKeys(fnUpdateUIWithKeys);
+            rpc->fetchAllPrivKeys(fnUpdateUIWithKeys, fnKeysFailed);
         }
         else {        
             if (Settings::getInstance()->isZAddress(addr)) {
@@ -1125,6 +1232,17 @@ void MainWindow::exportIVK(QString addr) {
         pui.buttonBox->button(QDialogButtonBox::Save)->setEnabled(true);
     };
 
+    // Some of the keys couldn't be exported. The others aren't shown, so they can't be saved as if
+    // they were the whole backup.
+    auto fnKeysFailed = [=](QStringList addrs) {
+        if (! *(isDialogAlive.get()) ) return;
+
+        pui.privKeyTxt->setPlainText(tr("The export failed."));
+        QMessageBox::critical(this, tr("Export failed"),
+            tr("The keys for these addresses couldn't be exported, so the export was stopped. Please try again.") + 
+            "\n\n" + addrs.join("\n"), QMessageBox::Ok);
+    };
+
     auto fnAddKey = [=](json key) {
         QList<QPair<QString, QString>> singleAddrKey;
         singleAddrKey.push_back(QPair<QString, QString>(addr, QString::fromStdString(key.get<json::string_t>())));
@@ -1132,7 +1250,7 @@ void MainWindow::exportIVK(QString addr) {
     };
 
     if (allKeys) {
-        rpc->fetchAllIVK(fnUpdateUIWithKeys);
+        rpc->fetchAllIVK(fnUpdateUIWithKeys, fnKeysFailed);
     } else {
         if (Settings::getInstance()->isZAddress(addr)) {
             rpc->fetchZIVK(addr, fnAddKey);
@@ -1230,6 +1348,8 @@ void MainWindow::setupBalancesTab() {
 
 void MainWindow::setupZcashdTab() {    
     ui->zcashdlogo->setBasePixmap(QPixmap(":/img/res/zcashdlogo.gif"));
+
+    QObject::connect(ui->btnSaveRPCStats, &QPushButton::clicked, this, &MainWindow::saveRPCStatistics);
 }
 
 void MainWindow::setupTransactionsTab() {
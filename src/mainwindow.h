@@ -122,6 +122,7 @@ private:
     void exportIVK(QString addr = "");
     void backupWalletDat();
     void exportTransactions();
+    void saveRPCStatistics();
 
     void doImport(QList<QString>* keys, int rescanHeight);
     void doImportFVK(QList<QString>* keys, int rescanHeight);
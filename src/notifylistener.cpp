@@ -0,0 +1,74 @@
+#include "notifylistener.h"
+
+NotifyListener::NotifyListener(QObject* parent) : QObject(parent) {
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+
+    QObject::connect(server, &QLocalServer::newConnection, [=] () {
+        while (server->hasPendingConnections()) {
+            auto socket = server->nextPendingConnection();
+
+            // The helper writes a single line and disconnects
+            QObject::connect(socket, &QLocalSocket::readyRead, [=] () { readMessages(socket); });
+            QObject::connect(socket, &QLocalSocket::disconnected, [=] () {
+                readMessages(socket);
+                socket->deleteLater();
+            });
+        }
+    });
+}
+
+bool NotifyListener::listen() {
+    // A wallet that crashed can leave its socket file behind. Only one wallet runs at a time,
+    // so it's safe to take it over.
+    QLocalServer::removeServer(socketName());
+
+    if (!server->listen(socketName())) {
+        qDebug() << "Couldn't listen for ycashd notifications:" << server->errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void NotifyListener::readMessages(QLocalSocket* socket) {
+    while (socket->canReadLine()) {
+        auto line  = QString::fromUtf8(socket->readLine()).trimmed();
+        auto kind  = line.section(' ', 0, 0);
+        auto arg   = line.section(' ', 1, 1);
+
+        if (kind == "block") {
+            received = true;
+            emit blockNotified(arg);
+        } else if (kind == "wallet") {
+            received = true;
+            emit walletNotified(arg);
+        }
+    }
+}
+
+QString NotifyListener::socketName() {
+    // Local socket names are per machine, so keep the wallets of different users apart
+    QString user = qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"));
+    return "yecwallet-notify-" + user;
+}
+
+QString NotifyListener::notifyCommand(const QString& kind) {
+    // ycashd runs this through the shell, and replaces %s with the block hash or txid
+    return "\"" % QDir::toNativeSeparators(QCoreApplication::applicationFilePath()) % "\" --notify " % kind % " %s";
+}
+
+bool NotifyListener::send(const QString& kind, const QString& arg) {
+    QLocalSocket socket;
+    socket.connectToServer(socketName());
+    if (!socket.waitForConnected(1000)) {
+        // The wallet isn't running, so there is nobody to tell
+        return false;
+    }
+
+    socket.write((kind % " " % arg % "\n").toUtf8());
+    socket.waitForBytesWritten(1000);
+    socket.disconnectFromServer();
+
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef NOTIFYLISTENER_H
+#define NOTIFYLISTENER_H
+
+#include "precompiled.h"
+
+/**
+ * Listens on a local socket for the block and wallet notifications that ycashd pushes through
+ * its -blocknotify and -walletnotify hooks. ycashd runs "yecwallet --notify <kind> <hash>",
+ * which hands the event to the running wallet and exits straight away.
+ */
+class NotifyListener : public QObject {
+    Q_OBJECT
+
+public:
+    NotifyListener(QObject* parent);
+
+    bool    listen();
+
+    // Whether ycashd has pushed anything yet, i.e. whether it is set up to notify us
+    bool    isReceiving() const { return received; }
+
+    // The command for ycashd's -blocknotify ("block") or -walletnotify ("wallet")
+    static QString  notifyCommand(const QString& kind);
+
+    // Used by the --notify helper to pass an event on to the running wallet
+    static bool     send(const QString& kind, const QString& arg);
+
+signals:
+    void    blockNotified(const QString& blockHash);
+    void    walletNotified(const QString& txid);
+
+private:
+    static QString  socketName();
+
+    void    readMessages(QLocalSocket* socket);
+
+    QLocalServer*   server;
+    bool            received    = false;
+};
+
+#endif // NOTIFYLISTENER_H
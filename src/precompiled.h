@@ -39,6 +39,7 @@
 #include <QPushButton>
 #include <QDateTime>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QSettings>
 #include <QStyle>
 #include <QFile>
@@ -58,10 +59,16 @@
 #include <QUrl>
 #include <QQueue>
 #include <QProcess>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
 #include <QDesktopServices>
 #include <QtNetwork/QNetworkRequest>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QTcpSocket>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
 #include <QtWebSockets/QtWebSockets>
 #include <QJsonDocument>
 #include <QJsonArray>
@@ -0,0 +1,139 @@
+#include "refreshengine.h"
+#include "settings.h"
+
+RefreshEngine::RefreshEngine(QObject* parent) : QObject(parent) {
+    // Stages report back even when their RPCs fail, but a reply can still get lost somewhere. Give
+    // up on the cycle if no stage has finished for a while, rather than waiting for it forever.
+    watchdog = new QTimer(this);
+    watchdog->setSingleShot(true);
+    QObject::connect(watchdog, &QTimer::timeout, [=] () {
+        QStringList waiting;
+        for (auto& stage : stages) {
+            if (!finishedAt.contains(stage.name))
+                waiting << stage.name;
+        }
+
+        qDebug() << "Refresh cycle" << cycleGeneration << "gave up waiting for" << waiting.join(", ");
+        cancel();
+    });
+}
+
+void RefreshEngine::addStage(const QString& name, const QStringList& inputs, const StageFn& run) {
+    for (auto& input : inputs) {
+        Q_ASSERT(std::any_of(stages.begin(), stages.end(), [&] (const Stage& s) { return s.name == input; }));
+    }
+
+    stages.append(Stage{ name, inputs, run });
+}
+
+void RefreshEngine::start(int generation) {
+    cancel();
+
+    running         = true;
+    cycleGeneration = generation;
+    started.clear();
+    finishedAt.clear();
+    cycleTimer.start();
+    watchdog->start(Settings::refreshCycleTimeout);
+
+    startReadyStages();
+}
+
+void RefreshEngine::cancel() {
+    if (!running)
+        return;
+
+    running = false;
+    watchdog->stop();
+    stats.cancelled++;
+
+    emit cycleCancelled(cycleGeneration);
+}
+
+void RefreshEngine::defer(bool force) {
+    if (pending) {
+        stats.merged++;
+    } else {
+        stats.deferred++;
+    }
+
+    pending       = true;
+    pendingForce |= force;
+}
+
+bool RefreshEngine::takeDeferred(bool* force) {
+    if (!pending)
+        return false;
+
+    *force       = pendingForce;
+    pending      = false;
+    pendingForce = false;
+
+    return true;
+}
+
+QString RefreshEngine::summary() const {
+    return QObject::tr("Refresh cycles: %1 done, %2 failed, %3 cancelled, %4 deferred, %5 merged. Last one took %6 ms")
+            .arg(stats.completed).arg(stats.failed).arg(stats.cancelled).arg(stats.deferred).arg(stats.merged)
+            .arg(stats.lastCycleMs);
+}
+
+void RefreshEngine::startReadyStages() {
+    for (auto& stage : stages) {
+        if (!running)
+            return;
+
+        if (started.contains(stage.name))
+            continue;
+
+        bool ready = std::all_of(stage.inputs.begin(), stage.inputs.end(),
+                                    [=] (const QString& input) { return finishedAt.contains(input); });
+        if (!ready)
+            continue;
+
+        started.insert(stage.name);
+
+        int generation = cycleGeneration;
+        QString name   = stage.name;
+        stage.run([=] () { stageDone(generation, name); }, [=] () { stageFailed(generation, name); });
+    }
+}
+
+void RefreshEngine::stageDone(int generation, const QString& name) {
+    // Left over from a cycle that was cancelled, or reported twice
+    if (!running || generation != cycleGeneration || finishedAt.contains(name))
+        return;
+
+    finishedAt[name] = cycleTimer.elapsed();
+
+    if (finishedAt.size() == stages.size()) {
+        running = false;
+        watchdog->stop();
+        stats.completed++;
+        stats.lastCycleMs = cycleTimer.elapsed();
+
+        emit cycleComplete(cycleGeneration, cycleTimer.elapsed());
+        return;
+    }
+
+    // The cycle is making progress, so the watchdog starts over
+    watchdog->start();
+    startReadyStages();
+}
+
+/**
+ * The stages that need this one can't run, so the cycle ends here. The stages that are still 
+ * running show what they fetched, but the cycle doesn't wait for them.
+ */
+void RefreshEngine::stageFailed(int generation, const QString& name) {
+    if (!running || generation != cycleGeneration || finishedAt.contains(name))
+        return;
+
+    qDebug() << "Refresh cycle" << cycleGeneration << "failed in" << name;
+
+    running = false;
+    watchdog->stop();
+    stats.failed++;
+
+    emit cycleFailed(cycleGeneration, name);
+}
@@ -0,0 +1,82 @@
+#ifndef REFRESHENGINE_H
+#define REFRESHENGINE_H
+
+#include "precompiled.h"
+
+/**
+ * Runs the stages of a refresh as a dependency graph. Each stage names the stages whose results
+ * it needs, and starts as soon as all of them have finished, so stages that don't depend on each
+ * other have their RPCs in flight at the same time. Starting a new cycle cancels the one that is
+ * still running: its remaining stages never start, and stages that finish late are ignored.
+ */
+class RefreshEngine : public QObject {
+    Q_OBJECT
+
+public:
+    // A stage calls done once it has finished, or failed if one of its RPCs failed, from whatever 
+    // callback that happens in. Every way a stage can end has to call one of them.
+    typedef std::function<void(const std::function<void(void)>& done, 
+                               const std::function<void(void)>& failed)> StageFn;
+
+    RefreshEngine(QObject* parent = nullptr);
+
+    // Inputs have to be declared before the stages that use them, which keeps the graph acyclic
+    void    addStage(const QString& name, const QStringList& inputs, const StageFn& run);
+
+    void    start(int generation);
+    void    cancel();
+
+    bool    isRunning() const   { return running; }
+    int     generation() const  { return cycleGeneration; }
+
+    // A refresh was asked for while a cycle is running. It is remembered, and any more that come 
+    // in before the cycle is done are merged into it.
+    void    defer(bool force);
+
+    // Take the refresh that was deferred while the last cycle ran, if there was one
+    bool    takeDeferred(bool* force);
+
+    struct Counters {
+        int     completed   = 0;
+        int     failed      = 0;
+        int     cancelled   = 0;
+        int     deferred    = 0;    // Refreshes asked for while a cycle was running
+        int     merged      = 0;    // ... while another one was already waiting
+        qint64  lastCycleMs = 0;
+    };
+    const Counters& counters() const { return stats; }
+    QString summary() const;
+
+    // How long each stage of the last cycle took, from the start of the cycle until it finished
+    const QMap<QString, qint64>& stageTimes() const { return finishedAt; }
+
+signals:
+    void    cycleComplete(int generation, qint64 elapsedMs);
+    void    cycleFailed(int generation, const QString& stage);
+    void    cycleCancelled(int generation);
+
+private:
+    struct Stage {
+        QString     name;
+        QStringList inputs;
+        StageFn     run;
+    };
+
+    void    startReadyStages();
+    void    stageDone(int generation, const QString& name);
+    void    stageFailed(int generation, const QString& name);
+
+    QList<Stage>            stages;
+    QSet<QString>           started;
+    QMap<QString, qint64>   finishedAt;
+
+    bool                    running         = false;
+    int                     cycleGeneration = -1;
+    bool                    pending         = false;
+    bool                    pendingForce    = false;
+    Counters                stats;
+    QElapsedTimer           cycleTimer;
+    QTimer*                 watchdog;
+};
+
+#endif // REFRESHENGINE_H
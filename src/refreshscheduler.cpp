@@ -0,0 +1,46 @@
+#include "refreshscheduler.h"
+#include "settings.h"
+
+RefreshScheduler::RefreshScheduler() {
+    clock.start();
+}
+
+bool RefreshScheduler::isInteracting() const {
+    return !hidden && lastActivity >= 0 && clock.elapsed() - lastActivity < Settings::userActivityWindow;
+}
+
+int RefreshScheduler::interval() const {
+    // The user is waiting for a send to show up
+    if (pendingOps > 0)
+        return Settings::quickUpdateSpeed;
+
+    // Every block is new during a sync, so each tick is a full refresh that slows the sync down
+    int speed = notifications ? Settings::notifyFallbackSpeed : Settings::updateSpeed;
+    if (syncing)
+        speed = std::max(speed, Settings::syncUpdateSpeed);
+    if (hidden)
+        speed = std::max(speed, Settings::hiddenUpdateSpeed);
+
+    // ycashd tells us about new blocks itself when notifications are on, so polling faster won't help
+    if (isInteracting() && !syncing && !notifications)
+        speed = std::min(speed, Settings::quickUpdateSpeed);
+
+    return speed;
+}
+
+QString RefreshScheduler::reason() const {
+    if (pendingOps > 0)
+        return QObject::tr("transactions pending");
+
+    QStringList reasons;
+    if (notifications)
+        reasons << QObject::tr("ycashd notifications");
+    if (syncing)
+        reasons << QObject::tr("syncing");
+    if (hidden)
+        reasons << QObject::tr("window hidden");
+    if (isInteracting() && !syncing && !notifications)
+        reasons << QObject::tr("in use");
+
+    return reasons.isEmpty() ? QObject::tr("normal") : reasons.join(", ");
+}
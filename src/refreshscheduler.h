@@ -0,0 +1,40 @@
+#ifndef REFRESHSCHEDULER_H
+#define REFRESHSCHEDULER_H
+
+#include "precompiled.h"
+
+/**
+ * Picks how often to poll ycashd. Sends that are still being computed and a user who is clicking
+ * around make it poll faster. A node that is still syncing, or a wallet nobody can see, makes it
+ * back off, so the refreshes don't compete with block validation for ycashd's attention.
+ */
+class RefreshScheduler {
+public:
+    RefreshScheduler();
+
+    void    setSyncing(bool s)          { syncing = s; }
+    void    setHidden(bool h)           { hidden = h; }
+    void    setPendingOps(int n)        { pendingOps = n; }
+    void    setNotifications(bool n)    { notifications = n; }
+
+    // The user did something in the wallet
+    void    userActive()                { lastActivity = clock.elapsed(); }
+
+    // The refresh interval for the current state, in ms
+    int     interval() const;
+
+    // Why that interval was picked, to show in the status tooltip
+    QString reason() const;
+
+private:
+    bool    isInteracting() const;
+
+    bool            syncing         = false;
+    bool            hidden          = false;
+    bool            notifications   = false;
+    int             pendingOps      = 0;
+    QElapsedTimer   clock;
+    qint64          lastActivity    = -1;
+};
+
+#endif // REFRESHSCHEDULER_H
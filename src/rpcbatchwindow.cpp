@@ -0,0 +1,69 @@
+#include "rpcbatchwindow.h"
+#include "settings.h"
+
+BatchWindow::BatchWindow(int numChunks, int maxWindow) {
+    for (int i = 0; i < numChunks; i++) {
+        queue.enqueue(i);
+    }
+
+    this->remaining = numChunks;
+    this->maxWindow = std::max(1, maxWindow);
+
+    // Start small, and let the answers show how much ycashd can take
+    this->window    = 1;
+
+    clock.start();
+}
+
+int BatchWindow::take() {
+    if (queue.isEmpty() || flying >= size() || clock.elapsed() < resumeAt)
+        return -1;
+
+    flying++;
+    return queue.dequeue();
+}
+
+void BatchWindow::answered(int, qint64 elapsedMs) {
+    flying--;
+    remaining--;
+    backoff = 0;
+
+    if (fastestMs < 0 || elapsedMs < fastestMs)
+        fastestMs = elapsedMs;
+
+    // Calls that queue up inside ycashd take longer, so slower answers mean the window is too big
+    if (elapsedMs > 2 * fastestMs + 100) {
+        window = std::max(1.0, window - 1);
+    } else {
+        window = std::min(static_cast<double>(maxWindow), window + 1);
+    }
+}
+
+void BatchWindow::failed(int) {
+    flying--;
+    remaining--;
+}
+
+bool BatchWindow::rejected(int chunk) {
+    flying--;
+    window = std::max(1.0, window / 2);
+
+    if (++rejections[chunk] > Settings::maxBatchRetries) {
+        remaining--;
+        return false;
+    }
+
+    // Sent again before anything else, once ycashd has had time to work through its queue
+    queue.prepend(chunk);
+    backoff++;
+    resumeAt = clock.elapsed() + retryDelay();
+
+    return true;
+}
+
+int BatchWindow::retryDelay() const {
+    if (backoff == 0)
+        return 0;
+
+    return std::min(Settings::batchRetryDelay << std::min(backoff - 1, 5), Settings::maxBatchRetryDelay);
+}
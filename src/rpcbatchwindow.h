@@ -0,0 +1,46 @@
+#ifndef RPCBATCHWINDOW_H
+#define RPCBATCHWINDOW_H
+
+#include "precompiled.h"
+
+/**
+ * Sliding window over the chunks of a large batch, so only a few of them are outstanding at
+ * any time. The window grows by one for every chunk that is answered about as fast as the
+ * fastest one so far, and shrinks by one when answers slow down. When ycashd's work queue is
+ * full the window is halved, and the rejected chunk is sent again after a growing delay.
+ */
+class BatchWindow {
+public:
+    BatchWindow(int numChunks = 0, int maxWindow = 1);
+
+    // The next chunk to send, or -1 if the window is full or nothing can be sent right now
+    int     take();
+
+    void    answered(int chunk, qint64 elapsedMs);
+    void    failed(int chunk);
+
+    // ycashd's work queue was full. Returns false if the chunk was rejected too many times and
+    // has been given up on.
+    bool    rejected(int chunk);
+
+    // How long to wait after the last rejection before sending again, in ms
+    int     retryDelay() const;
+
+    bool    done() const        { return remaining == 0; }
+    int     inFlight() const    { return flying; }
+    int     size() const        { return static_cast<int>(window); }
+
+private:
+    QQueue<int>     queue;
+    QHash<int, int> rejections;     // Per chunk
+    double          window;
+    int             maxWindow;
+    int             flying          = 0;
+    int             remaining;
+    qint64          fastestMs       = -1;
+    int             backoff         = 0;    // Rejections since the last answer
+    QElapsedTimer   clock;
+    qint64          resumeAt        = 0;
+};
+
+#endif // RPCBATCHWINDOW_H
@@ -0,0 +1,445 @@
+#include "rpcdecoder.h"
+#include "settings.h"
+
+bool ResultRecordsDecoder::decode(const QByteArray& body) {
+    return decode(body.constData(), static_cast<std::size_t>(body.size()));
+}
+
+bool ResultRecordsDecoder::decode(const char* data, std::size_t size) {
+    stack.clear();
+    lastKey.clear();
+    responseId = -1;
+    failed     = false;
+    error.clear();
+
+    // Parses straight over the buffer, without copying it.
+    return json::sax_parse(data, data + size, this);
+}
+
+bool ResultRecordsDecoder::null() {
+    scalar(nullptr);
+    return true;
+}
+
+bool ResultRecordsDecoder::boolean(bool val) {
+    scalar([&] () { boolField(lastKey, val); });
+    return true;
+}
+
+bool ResultRecordsDecoder::number_integer(number_integer_t val) {
+    if (!stack.empty() && stack.back() == Frame::Response && lastKey == "id") {
+        responseId = val;
+        return true;
+    }
+
+    number(static_cast<double>(val));
+    return true;
+}
+
+bool ResultRecordsDecoder::number_unsigned(number_unsigned_t val) {
+    if (!stack.empty() && stack.back() == Frame::Response && lastKey == "id") {
+        responseId = static_cast<qint64>(val);
+        return true;
+    }
+
+    number(static_cast<double>(val));
+    return true;
+}
+
+bool ResultRecordsDecoder::number_float(number_float_t val, const string_t&) {
+    number(val);
+    return true;
+}
+
+void ResultRecordsDecoder::number(double val) {
+    if (!stack.empty() && stack.back() == Frame::Response && lastKey == "result") {
+        numberResult(val);
+        return;
+    }
+
+    scalar([&] () { numberField(lastKey, val); });
+}
+
+bool ResultRecordsDecoder::string(string_t& val) {
+    if (!stack.empty() && stack.back() == Frame::Error && lastKey == "message") {
+        error = QString::fromStdString(val);
+        return true;
+    }
+
+    if (!stack.empty() && stack.back() == Frame::ResultArray) {
+        stringItem(val);
+        return true;
+    }
+
+    if (!stack.empty() && stack.back() == Frame::Response && lastKey == "result") {
+        stringResult(val);
+        return true;
+    }
+
+    scalar([&] () { stringField(lastKey, val); });
+    return true;
+}
+
+// Scalars only matter as fields of a record, or of the result that holds the records
+void ResultRecordsDecoder::scalar(const std::function<void(void)>& recordField) {
+    if (!stack.empty() && (stack.back() == Frame::Record || stack.back() == Frame::Wrapper) && recordField)
+        recordField();
+}
+
+bool ResultRecordsDecoder::start_object(std::size_t) {
+    if (stack.empty() || stack.back() == Frame::Batch) {
+        stack.push_back(Frame::Response);
+        responseId = -1;
+        failed     = false;
+    } else if (stack.back() == Frame::Response && lastKey == "result" && recordsField() != nullptr) {
+        stack.push_back(Frame::Wrapper);
+    } else if (stack.back() == Frame::ResultArray ||
+                (stack.back() == Frame::Response && lastKey == "result")) {
+        stack.push_back(Frame::Record);
+        beginRecord();
+    } else if (stack.back() == Frame::Response && lastKey == "error") {
+        stack.push_back(Frame::Error);
+        failed = true;
+    } else {
+        stack.push_back(Frame::Skip);
+    }
+
+    return true;
+}
+
+bool ResultRecordsDecoder::key(string_t& val) {
+    // Keys of nested objects inside a record are never looked at
+    if (stack.back() != Frame::Skip)
+        lastKey = std::move(val);
+    return true;
+}
+
+bool ResultRecordsDecoder::end_object() {
+    Frame frame = stack.back();
+    stack.pop_back();
+
+    if (frame == Frame::Record) {
+        endRecord();
+    } else if (frame == Frame::Response) {
+        endResponse(responseId);
+    }
+
+    lastKey.clear();
+    return true;
+}
+
+bool ResultRecordsDecoder::start_array(std::size_t) {
+    if (stack.empty()) {
+        stack.push_back(Frame::Batch);
+    } else if ((stack.back() == Frame::Response && lastKey == "result") ||
+                (stack.back() == Frame::Wrapper && lastKey == recordsField())) {
+        stack.push_back(Frame::ResultArray);
+    } else {
+        stack.push_back(Frame::Skip);
+    }
+
+    return true;
+}
+
+bool ResultRecordsDecoder::end_array() {
+    stack.pop_back();
+    return true;
+}
+
+const QString& ResultRecordsDecoder::shared(const string_t& val) {
+    // Look up without copying the bytes. Only a miss makes a deep copy of the key.
+    auto key = QByteArray::fromRawData(val.data(), static_cast<int>(val.size()));
+    auto it = strings.constFind(key);
+    if (it != strings.constEnd())
+        return it.value();
+
+    return strings.insert(QByteArray(val.data(), static_cast<int>(val.size())), 
+                            QString::fromUtf8(val.data(), static_cast<int>(val.size()))).value();
+}
+
+bool ResultRecordsDecoder::parse_error(std::size_t position, const std::string& last_token,
+                                        const nlohmann::detail::exception& ex) {
+    qDebug() << "Couldn't parse RPC reply at" << position << QString::fromStdString(last_token) << ex.what();
+    return false;
+}
+
+
+/***********************************************************************************
+ *  listunspent / z_listunspent
+ ************************************************************************************/
+void UnspentList::merge(const UnspentList& other) {
+    utxos.append(other.utxos);
+    for (auto it = other.balances.constBegin(); it != other.balances.constEnd(); it++) {
+        balances[it.key()].add(it.value());
+    }
+
+    anyUnconfirmed |= other.anyUnconfirmed;
+    transparent.add(other.transparent);
+    sapling.add(other.sapling);
+    sprout.add(other.sprout);
+}
+
+void UnspentDecoder::beginRecord() {
+    // Older ycashds don't say whether an output is spendable, and only list the ones that are
+    current = UnspentOutput{ "", "", 0, "", 0, true };
+    amount  = 0;
+}
+
+void UnspentDecoder::endRecord() {
+    bool confirmed = current.confirmations > 0;
+    if (!confirmed) {
+        result.anyUnconfirmed = true;
+    }
+
+    current.amount = Settings::getDecimalString(amount);
+    result.utxos.push_back(current);
+
+    result.balances[current.address].add(amount, confirmed);
+
+    if (current.spendable) {
+        switch (current.pool) {
+        case UnspentOutput::Transparent: result.transparent.add(amount, confirmed); break;
+        case UnspentOutput::Sapling:     result.sapling.add(amount, confirmed);     break;
+        case UnspentOutput::Sprout:      result.sprout.add(amount, confirmed);      break;
+        }
+    }
+}
+
+void UnspentDecoder::stringField(const std::string& key, string_t& val) {
+    if (key == "address") {
+        current.address = shared(val);
+    } else if (key == "txid") {
+        current.txid = shared(val);
+    }
+}
+
+void UnspentDecoder::numberField(const std::string& key, double val) {
+    if (key == "amount") {
+        amount = val;
+    } else if (key == "confirmations") {
+        current.confirmations = static_cast<int>(val);
+    } else if (key == "vout" || key == "outindex" || key == "jsoutindex") {
+        current.outindex = static_cast<int>(val);
+    } else if (key == "jsindex") {
+        current.jsindex = static_cast<int>(val);
+    }
+
+    // Sapling notes have an outindex, Sprout notes are in a JoinSplit
+    if (key == "outindex") {
+        current.pool = UnspentOutput::Sapling;
+    } else if (key == "jsindex" || key == "jsoutindex") {
+        current.pool = UnspentOutput::Sprout;
+    }
+}
+
+void UnspentDecoder::boolField(const std::string& key, bool val) {
+    if (key == "spendable") {
+        current.spendable = val;
+    }
+}
+
+
+/***********************************************************************************
+ *  listtransactions / listsinceblock
+ ************************************************************************************/
+void TxEntriesDecoder::beginRecord() {
+    current = TransactionItem{ "", 0, "", "", 0, 0, "", "" };
+    fee     = 0;
+}
+
+void TxEntriesDecoder::endRecord() {
+    current.amount += fee;
+    addTransaction(current);
+}
+
+void TxEntriesDecoder::stringField(const std::string& key, string_t& val) {
+    if (key == "category") {
+        current.type = shared(val);
+    } else if (key == "address") {
+        current.address = shared(val);
+    } else if (key == "txid") {
+        current.txid = shared(val);
+    } else if (key == "blockhash") {
+        current.blockhash = shared(val);
+    }
+}
+
+void TxEntriesDecoder::numberField(const std::string& key, double val) {
+    if (key == "amount") {
+        current.amount = val;
+    } else if (key == "fee") {
+        fee = val;
+    } else if (key == "time") {
+        current.datetime = static_cast<qint64>(val);
+    } else if (key == "confirmations") {
+        current.confirmations = static_cast<long>(val);
+    } else if (key == "vout") {
+        current.vout = static_cast<int>(val);
+    }
+}
+
+void SinceBlockDecoder::stringField(const std::string& key, string_t& val) {
+    // Outside the tx entries, only the block to ask from next time
+    if (key == "lastblock") {
+        result.lastBlock = QString::fromStdString(val);
+        return;
+    }
+
+    TxEntriesDecoder::stringField(key, val);
+}
+
+
+/***********************************************************************************
+ *  z_listreceivedbyaddress (batch)
+ ************************************************************************************/
+void ReceivedNotesDecoder::beginRecord() {
+    current = ReceivedNote{ "", 0, "", false };
+}
+
+void ReceivedNotesDecoder::endRecord() {
+    pending.push_back(current);
+}
+
+void ReceivedNotesDecoder::stringField(const std::string& key, string_t& val) {
+    if (key == "txid") {
+        current.txid = shared(val);
+    } else if (key == "memo") {
+        // Memos come hex encoded, and an empty one starts with f600
+        auto hex = QByteArray::fromRawData(val.data(), static_cast<int>(val.size()));
+        if (!hex.startsWith("f600")) {
+            QString memo(QByteArray::fromHex(hex));
+            if (!memo.trimmed().isEmpty())
+                current.memo = memo;
+        }
+    }
+}
+
+void ReceivedNotesDecoder::numberField(const std::string& key, double val) {
+    if (key == "amount") {
+        current.amount = val;
+    }
+}
+
+void ReceivedNotesDecoder::boolField(const std::string& key, bool val) {
+    if (key == "change") {
+        current.change = val;
+    }
+}
+
+void ReceivedNotesDecoder::endResponse(qint64 id) {
+    // Failed calls have no result, so they don't show up in the map
+    if (id >= 0 && !responseFailed())
+        notes[static_cast<int>(id)] = pending;
+
+    pending.clear();
+}
+
+
+/***********************************************************************************
+ *  gettransaction (batch)
+ ************************************************************************************/
+void TxDetailsDecoder::beginRecord() {
+    haveRecord = true;
+    haveTime   = false;
+    time       = 0;
+    blocktime  = 0;
+    current    = TxDetails{ 0, 0 };
+}
+
+void TxDetailsDecoder::endRecord() {
+    current.datetime  = haveTime ? time : blocktime;
+    current.blocktime = blocktime;
+}
+
+void TxDetailsDecoder::stringField(const std::string& key, string_t& val) {
+    if (key == "blockhash") {
+        current.blockhash = shared(val);
+    }
+}
+
+void TxDetailsDecoder::numberField(const std::string& key, double val) {
+    if (key == "time") {
+        haveTime = true;
+        time = static_cast<qint64>(val);
+    } else if (key == "blocktime") {
+        blocktime = static_cast<qint64>(val);
+    } else if (key == "confirmations") {
+        current.confirmations = static_cast<long>(val);
+    }
+}
+
+void TxDetailsDecoder::endResponse(qint64 id) {
+    if (id >= 0 && haveRecord)
+        details[static_cast<int>(id)] = current;
+
+    haveRecord = false;
+}
+
+
+/***********************************************************************************
+ *  getinfo / getblockchaininfo
+ ************************************************************************************/
+void NodeInfoDecoder::numberField(const std::string& key, double val) {
+    if (key == "version") {
+        result.version = static_cast<int>(val);
+    } else if (key == "blocks") {
+        result.blocks = static_cast<int>(val);
+    } else if (key == "connections") {
+        result.connections = static_cast<int>(val);
+    }
+}
+
+void NodeInfoDecoder::boolField(const std::string& key, bool val) {
+    if (key == "testnet") {
+        result.hasTestnet = true;
+        result.testnet = val;
+    }
+}
+
+void BlockchainInfoDecoder::numberField(const std::string& key, double val) {
+    if (key == "verificationprogress") {
+        result.verificationProgress = val;
+    } else if (key == "blocks") {
+        result.blocks = static_cast<int>(val);
+    } else if (key == "estimatedheight") {
+        result.estimatedHeight = static_cast<int>(val);
+    }
+}
+
+
+
+/***********************************************************************************
+ *  getblockhash (batch)
+ ************************************************************************************/
+void StringResultsDecoder::endResponse(qint64 id) {
+    if (id >= 0 && haveResult)
+        results[static_cast<int>(id)] = current;
+
+    haveResult = false;
+}
+
+
+
+/***********************************************************************************
+ *  z_listaddresses / getaddressesbyaccount
+ ************************************************************************************/
+void AddressListDecoder::stringItem(string_t& val) {
+    result.push_back(QString::fromUtf8(val.data(), static_cast<int>(val.size())));
+}
+
+
+
+/***********************************************************************************
+ *  getblockheader
+ ************************************************************************************/
+void BlockHeightsDecoder::numberField(const std::string& key, double val) {
+    if (key == "height")
+        current = static_cast<int>(val);
+}
+
+void BlockHeightsDecoder::endResponse(qint64 id) {
+    if (id >= 0 && current > 0)
+        heights[static_cast<int>(id)] = current;
+
+    current = 0;
+}
@@ -0,0 +1,321 @@
+#ifndef RPCDECODER_H
+#define RPCDECODER_H
+
+#include "precompiled.h"
+
+#include "datamodel.h"
+
+using json = nlohmann::json;
+
+/**
+ * SAX handler that walks a JSON-RPC response, or a batch array of responses, and reports the
+ * "result" of each response as flat records of scalar fields, without building a json DOM.
+ * If the result is an array, every object in it is a record. If the result is an object, it is
+ * the only record, unless the decoder names a field of it that holds the records, like the 
+ * "transactions" of listsinceblock. Then the other scalar fields of the result are reported as
+ * fields outside any record. Nested objects and arrays inside a record are skipped. Strings 
+ * directly in a result array, and a result that is just a number or string, are reported on their own.
+ */
+class ResultRecordsDecoder : public nlohmann::json_sax<json> {
+public:
+    virtual ~ResultRecordsDecoder() = default;
+
+    // Decode a reply body. Returns false if the body isn't valid JSON.
+    bool decode(const QByteArray& body);
+    bool decode(const char* data, std::size_t size);
+
+    // The error message of the last failed response, if any
+    const QString& errorMessage() const { return error; }
+
+    bool null() override;
+    bool boolean(bool val) override;
+    bool number_integer(number_integer_t val) override;
+    bool number_unsigned(number_unsigned_t val) override;
+    bool number_float(number_float_t val, const string_t& s) override;
+    bool string(string_t& val) override;
+    bool start_object(std::size_t elements) override;
+    bool key(string_t& val) override;
+    bool end_object() override;
+    bool start_array(std::size_t elements) override;
+    bool end_array() override;
+    bool parse_error(std::size_t position, const std::string& last_token,
+                        const nlohmann::detail::exception& ex) override;
+
+protected:
+    virtual void beginRecord() {}
+    virtual void endRecord() {}
+
+    virtual void stringField(const std::string& /*key*/, string_t& /*val*/) {}
+    virtual void numberField(const std::string& /*key*/, double /*val*/) {}
+    virtual void boolField  (const std::string& /*key*/, bool /*val*/) {}
+
+    virtual void stringItem (string_t& /*val*/) {}
+    virtual void numberResult(double /*val*/) {}
+    virtual void stringResult(string_t& /*val*/) {}
+
+    // The field of an object result that holds the records, if they aren't the result itself
+    virtual const char* recordsField() const { return nullptr; }
+
+    // Called at the end of every response, with its integer id, or -1 if the id isn't an integer.
+    virtual void endResponse(qint64 /*id*/) {}
+
+    // Whether the response being decoded has an error instead of a result
+    bool responseFailed() const { return failed; }
+
+    // Convert a string field to a QString. Equal values, like an address that shows up in
+    // many records, share a single QString instead of each getting its own copy.
+    const QString& shared(const string_t& val);
+
+private:
+    enum Frame { Batch, Response, ResultArray, Record, Wrapper, Error, Skip };
+
+    void scalar(const std::function<void(void)>& recordField);
+    void number(double val);
+
+    std::vector<Frame>  stack;
+    std::string         lastKey;
+    qint64              responseId  = -1;
+    bool                failed      = false;
+    QString             error;
+
+    QHash<QByteArray, QString> strings;
+};
+
+// The UTXOs from a listunspent or z_listunspent reply, with the balance of each address and pool
+struct UnspentList {
+    QList<UnspentOutput>    utxos;
+    QMap<QString, Balance>  balances;
+    bool                    anyUnconfirmed  = false;
+
+    // Only outputs we can spend, which leaves out watch-only ones, like z_gettotalbalance does
+    Balance                 transparent;
+    Balance                 sapling;
+    Balance                 sprout;
+
+    Balance shielded() const { Balance b = sapling; b.add(sprout); return b; }
+    Balance total() const    { Balance b = shielded(); b.add(transparent); return b; }
+
+    // Add in the UTXOs and balances of another reply
+    void    merge(const UnspentList& other);
+};
+
+/**
+ * Decodes listunspent and z_listunspent replies straight into UnspentOutputs, and sums up
+ * the balances of each address and pool as it goes.
+ */
+class UnspentDecoder : public ResultRecordsDecoder {
+public:
+    UnspentList             result;
+
+protected:
+    void beginRecord() override;
+    void endRecord() override;
+    void stringField(const std::string& key, string_t& val) override;
+    void numberField(const std::string& key, double val) override;
+    void boolField  (const std::string& key, bool val) override;
+
+private:
+    UnspentOutput           current;
+    double                  amount;
+};
+
+/**
+ * Decodes the wallet tx entries of a listtransactions or listsinceblock reply into TransactionItems.
+ */
+class TxEntriesDecoder : public ResultRecordsDecoder {
+protected:
+    virtual void addTransaction(const TransactionItem& tx) = 0;
+
+    void beginRecord() override;
+    void endRecord() override;
+    void stringField(const std::string& key, string_t& val) override;
+    void numberField(const std::string& key, double val) override;
+
+private:
+    TransactionItem         current;
+    double                  fee;
+};
+
+class TransactionsDecoder : public TxEntriesDecoder {
+public:
+    QList<TransactionItem>  result;
+
+protected:
+    void addTransaction(const TransactionItem& tx) override { result.push_back(tx); }
+};
+
+// The wallet txs since a block, and the block to ask from next time
+struct SinceBlock {
+    QList<TransactionItem>  transactions;
+    QString                 lastBlock;
+};
+
+class SinceBlockDecoder : public TxEntriesDecoder {
+public:
+    SinceBlock              result;
+
+protected:
+    const char* recordsField() const override { return "transactions"; }
+
+    void addTransaction(const TransactionItem& tx) override { result.transactions.push_back(tx); }
+    void stringField(const std::string& key, string_t& val) override;
+};
+
+// A note received by a y-Addr, as reported by z_listreceivedbyaddress
+struct ReceivedNote {
+    QString txid;
+    double  amount;
+    QString memo;       // As text, empty if the note has none
+    bool    change;
+};
+
+/**
+ * Decodes a batch of z_listreceivedbyaddress replies, keyed by the id of each call.
+ */
+class ReceivedNotesDecoder : public ResultRecordsDecoder {
+public:
+    QMap<int, QList<ReceivedNote>>  notes;
+
+protected:
+    void beginRecord() override;
+    void endRecord() override;
+    void stringField(const std::string& key, string_t& val) override;
+    void numberField(const std::string& key, double val) override;
+    void boolField  (const std::string& key, bool val) override;
+    void endResponse(qint64 id) override;
+
+private:
+    QList<ReceivedNote>     pending;
+    ReceivedNote            current;
+};
+
+// The parts of a gettransaction reply that are shown in the transactions table
+struct TxDetails {
+    qint64  datetime;
+    long    confirmations;
+    qint64  blocktime       = 0;
+    QString blockhash;              // Empty until the tx is mined
+    int     height          = 0;    // The height of blockhash, once it has been looked up
+};
+
+/**
+ * Decodes a batch of gettransaction replies, keyed by the id of each call.
+ */
+class TxDetailsDecoder : public ResultRecordsDecoder {
+public:
+    QMap<int, TxDetails>    details;
+
+protected:
+    void beginRecord() override;
+    void endRecord() override;
+    void stringField(const std::string& key, string_t& val) override;
+    void numberField(const std::string& key, double val) override;
+    void endResponse(qint64 id) override;
+
+private:
+    bool                    haveRecord  = false;
+    bool                    haveTime;
+    qint64                  time;
+    qint64                  blocktime;
+    TxDetails               current;
+};
+
+// The parts of getinfo the wallet uses
+struct NodeInfo {
+    int     version         = 0;
+    int     blocks          = 0;
+    int     connections     = 0;
+    bool    hasTestnet      = false;
+    bool    testnet         = false;
+};
+
+class NodeInfoDecoder : public ResultRecordsDecoder {
+public:
+    NodeInfo                result;
+
+protected:
+    void numberField(const std::string& key, double val) override;
+    void boolField  (const std::string& key, bool val) override;
+};
+
+// The parts of getblockchaininfo the wallet uses
+struct BlockchainInfo {
+    double  verificationProgress    = 0;
+    int     blocks                  = 0;
+    int     estimatedHeight         = 0;    // 0 if ycashd doesn't report it
+};
+
+class BlockchainInfoDecoder : public ResultRecordsDecoder {
+public:
+    BlockchainInfo          result;
+
+protected:
+    void numberField(const std::string& key, double val) override;
+};
+
+/**
+ * Decodes a result that is a plain list of addresses, like z_listaddresses and getaddressesbyaccount.
+ */
+class AddressListDecoder : public ResultRecordsDecoder {
+public:
+    QList<QString>          result;
+
+protected:
+    void stringItem(string_t& val) override;
+};
+
+/**
+ * Decodes a result that is a single number, like getnetworksolps.
+ */
+class NumberDecoder : public ResultRecordsDecoder {
+public:
+    double                  result  = 0;
+
+protected:
+    void numberResult(double val) override { result = val; }
+};
+
+/**
+ * Decodes a result that is a single string, like getbestblockhash.
+ */
+class StringDecoder : public ResultRecordsDecoder {
+public:
+    QString                 result;
+
+protected:
+    void stringResult(string_t& val) override { result = QString::fromStdString(val); }
+};
+
+/**
+ * Decodes a batch of replies whose result is a single string, like getblockhash, keyed by the
+ * id of each call.
+ */
+class StringResultsDecoder : public ResultRecordsDecoder {
+public:
+    QMap<int, QString>      results;
+
+protected:
+    void stringResult(string_t& val) override { current = QString::fromStdString(val); haveResult = true; }
+    void endResponse(qint64 id) override;
+
+private:
+    bool                    haveResult  = false;
+    QString                 current;
+};
+
+/**
+ * Decodes a batch of getblockheader replies into the heights of the blocks, keyed by the id of each call.
+ */
+class BlockHeightsDecoder : public ResultRecordsDecoder {
+public:
+    QMap<int, int>          heights;
+
+protected:
+    void numberField(const std::string& key, double val) override;
+    void endResponse(qint64 id) override;
+
+private:
+    int                     current     = 0;
+};
+
+#endif // RPCDECODER_H
@@ -0,0 +1,166 @@
+#ifndef RPCMETHODS_H
+#define RPCMETHODS_H
+
+#include "precompiled.h"
+
+#include "rpcdecoder.h"
+
+/**
+ * Writes a JSON-RPC request body straight into a buffer that is sized once up front, instead of
+ * building a json object and dumping it.
+ */
+class RPCRequestWriter {
+public:
+    explicit RPCRequestWriter(const char* method) {
+        body.reserve(128);
+        body.append("{\"jsonrpc\":\"1.0\",\"id\":\"someid\",\"method\":\"");
+        body.append(method);
+        body.append("\",\"params\":[");
+    }
+
+    void add(int val)               { separator(); body.append(QByteArray::number(val)); }
+    void add(qint64 val)            { separator(); body.append(QByteArray::number(val)); }
+    void add(bool val)              { separator(); body.append(val ? "true" : "false"); }
+    void add(const QString& val) {
+        separator();
+        body.append('"');
+        for (char c : val.toUtf8()) {
+            switch (c) {
+                case '"':  body.append("\\\""); break;
+                case '\\': body.append("\\\\"); break;
+                case '\n': body.append("\\n");  break;
+                case '\r': body.append("\\r");  break;
+                case '\t': body.append("\\t");  break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        body.append(QString("\\u%1").arg(static_cast<int>(c), 4, 16, QChar('0')).toLatin1());
+                    } else {
+                        body.append(c);
+                    }
+            }
+        }
+        body.append('"');
+    }
+
+    QByteArray finish()             { body.append("]}"); return body; }
+
+private:
+    void separator()                { if (params++ > 0) body.append(','); }
+
+    QByteArray  body;
+    int         params  = 0;
+};
+
+
+/***********************************************************************************
+ *  Parameters. Each one writes itself, in order, into the "params" array.
+ ************************************************************************************/
+struct NoParams {
+    void write(RPCRequestWriter&) const {}
+};
+
+struct MinConfParams {
+    int     minconf = 0;    // 0 includes unconfirmed
+    void write(RPCRequestWriter& w) const { w.add(minconf); }
+};
+
+struct AccountParams {
+    QString account;        // "" is the default account
+    void write(RPCRequestWriter& w) const { w.add(account); }
+};
+
+struct ListTransactionsParams {
+    QString account = "*";  // All accounts
+    int     count   = 10;
+    int     skip    = 0;
+    void write(RPCRequestWriter& w) const { w.add(account); w.add(count); w.add(skip); }
+};
+
+struct BlockHashParams {
+    QString blockhash;
+    void write(RPCRequestWriter& w) const { w.add(blockhash); }
+};
+
+
+/***********************************************************************************
+ *  Method descriptors. Each one names the RPC, the params it takes, what it returns
+ *  and the decoder that fills the result from the reply.
+ ************************************************************************************/
+struct GetInfoRPC {
+    static const char* method() { return "getinfo"; }
+    typedef NoParams                Params;
+    typedef NodeInfo                Result;
+    typedef NodeInfoDecoder         Decoder;
+};
+
+struct GetBlockchainInfoRPC {
+    static const char* method() { return "getblockchaininfo"; }
+    typedef NoParams                Params;
+    typedef BlockchainInfo          Result;
+    typedef BlockchainInfoDecoder   Decoder;
+};
+
+struct ListUnspentRPC {
+    static const char* method() { return "listunspent"; }
+    typedef MinConfParams           Params;
+    typedef UnspentList             Result;
+    typedef UnspentDecoder          Decoder;
+};
+
+struct ZListUnspentRPC {
+    static const char* method() { return "z_listunspent"; }
+    typedef MinConfParams           Params;
+    typedef UnspentList             Result;
+    typedef UnspentDecoder          Decoder;
+};
+
+struct ListTransactionsRPC {
+    static const char* method() { return "listtransactions"; }
+    typedef ListTransactionsParams  Params;
+    typedef QList<TransactionItem>  Result;
+    typedef TransactionsDecoder     Decoder;
+};
+
+struct ListSinceBlockRPC {
+    static const char* method() { return "listsinceblock"; }
+    typedef BlockHashParams         Params;
+    typedef SinceBlock              Result;
+    typedef SinceBlockDecoder       Decoder;
+};
+
+struct GetBestBlockHashRPC {
+    static const char* method() { return "getbestblockhash"; }
+    typedef NoParams                Params;
+    typedef QString                 Result;
+    typedef StringDecoder           Decoder;
+};
+
+struct ZListAddressesRPC {
+    static const char* method() { return "z_listaddresses"; }
+    typedef NoParams                Params;
+    typedef QList<QString>          Result;
+    typedef AddressListDecoder      Decoder;
+};
+
+struct GetAddressesByAccountRPC {
+    static const char* method() { return "getaddressesbyaccount"; }
+    typedef AccountParams           Params;
+    typedef QList<QString>          Result;
+    typedef AddressListDecoder      Decoder;
+};
+
+struct GetNetworkSolPsRPC {
+    static const char* method() { return "getnetworksolps"; }
+    typedef NoParams                Params;
+    typedef double                  Result;
+    typedef NumberDecoder           Decoder;
+};
+
+template<class Method>
+QByteArray serializeRPC(const typename Method::Params& params) {
+    RPCRequestWriter w(Method::method());
+    params.write(w);
+    return w.finish();
+}
+
+#endif // RPCMETHODS_H
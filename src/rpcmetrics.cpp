@@ -0,0 +1,240 @@
+#include "rpcmetrics.h"
+
+/***********************************************************************************
+ *  LatencyHistogram
+ ************************************************************************************/
+LatencyHistogram::LatencyHistogram() {
+    counts.fill(0, bounds().size() + 1);
+}
+
+// Bucket upper bounds in ms: 1, 2, 3, 4, 6, 8, 12, 16, 24 ... up to about 10 minutes.
+// Anything slower lands in the overflow bucket at the end.
+const QVector<qint64>& LatencyHistogram::bounds() {
+    static const QVector<qint64> b = [] () {
+        QVector<qint64> v;
+        for (qint64 p = 1; p <= 512 * 1024; p *= 2) {
+            v.push_back(p);
+            if (p > 1)
+                v.push_back(p + p / 2);
+        }
+        return v;
+    }();
+
+    return b;
+}
+
+void LatencyHistogram::add(qint64 ms) {
+    auto& b = bounds();
+    auto bucket = std::lower_bound(b.begin(), b.end(), ms) - b.begin();
+
+    counts[static_cast<int>(bucket)]++;
+    total++;
+    sumMs += ms;
+    maxMs = std::max(maxMs, ms);
+}
+
+qint64 LatencyHistogram::percentile(double q) const {
+    if (total == 0)
+        return 0;
+
+    qint64 rank = static_cast<qint64>(std::ceil(q * total));
+    qint64 seen = 0;
+    for (int i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The bucket bound can overshoot the slowest call actually seen
+            return i < bounds().size() ? std::min(bounds()[i], maxMs) : maxMs;
+        }
+    }
+
+    return maxMs;
+}
+
+
+/***********************************************************************************
+ *  RPCMetrics
+ ************************************************************************************/
+void RPCMetrics::started(const QString& method, qint64 bytesOut) {
+    auto& s = stats[method];
+    s.calls++;
+    s.bytesOut += bytesOut;
+    s.inFlight++;
+}
+
+void RPCMetrics::finished(const QString& method, qint64 elapsedMs, qint64 bytesIn, bool error) {
+    auto& s = stats[method];
+    s.inFlight = std::max(0, s.inFlight - 1);
+    s.bytesIn += bytesIn;
+    if (error)
+        s.errors++;
+
+    s.latency.add(elapsedMs);
+}
+
+QStringList RPCMetrics::summary() const {
+    QStringList lines;
+    for (auto it = stats.constBegin(); it != stats.constEnd(); it++) {
+        auto& s = it.value();
+        lines << QString("rpc %1: calls=%2 errors=%3 timeouts=%4 cancelled=%5 retries=%6 coalesced=%7 inflight=%8 p50=%9ms p95=%10ms p99=%11ms max=%12ms out=%13B in=%14B")
+                    .arg(it.key())
+                    .arg(s.calls).arg(s.errors).arg(s.timeouts).arg(s.cancelled).arg(s.retries).arg(s.coalesced).arg(s.inFlight)
+                    .arg(s.latency.percentile(0.50))
+                    .arg(s.latency.percentile(0.95))
+                    .arg(s.latency.percentile(0.99))
+                    .arg(s.latency.max())
+                    .arg(s.bytesOut).arg(s.bytesIn);
+    }
+
+    if (scheduler) {
+        lines << QString("rpc queue: inflight=%1 max=%2").arg(scheduler->inFlight()).arg(scheduler->getMaxInFlight());
+        for (int p = 0; p < RPCPriority::NumPriorities; p++) {
+            auto priority = static_cast<RPCPriority>(p);
+            lines << QString("rpc queue:%1: inflight=%2 queued=%3 maxqueued=%4")
+                        .arg(RPCScheduler::priorityName(priority))
+                        .arg(scheduler->inFlight(priority))
+                        .arg(scheduler->queueDepth(priority))
+                        .arg(scheduler->maxQueueDepth(priority));
+        }
+    }
+
+    return lines;
+}
+
+json RPCMetrics::toJson() const {
+    json methods = json::object();
+    for (auto it = stats.constBegin(); it != stats.constEnd(); it++) {
+        auto& s = it.value();
+        methods[it.key().toStdString()] = {
+            {"calls",     s.calls},
+            {"errors",    s.errors},
+            {"timeouts",  s.timeouts},
+            {"cancelled", s.cancelled},
+            {"retries",   s.retries},
+            {"coalesced", s.coalesced},
+            {"inflight",  s.inFlight},
+            {"bytes_out", s.bytesOut},
+            {"bytes_in",  s.bytesIn},
+            {"latency_ms", {
+                {"mean", s.latency.mean()},
+                {"p50",  s.latency.percentile(0.50)},
+                {"p95",  s.latency.percentile(0.95)},
+                {"p99",  s.latency.percentile(0.99)},
+                {"max",  s.latency.max()}
+            }}
+        };
+    }
+
+    json queues = json::object();
+    if (scheduler) {
+        queues["inflight"]     = scheduler->inFlight();
+        queues["max_inflight"] = scheduler->getMaxInFlight();
+        for (int p = 0; p < RPCPriority::NumPriorities; p++) {
+            auto priority = static_cast<RPCPriority>(p);
+            queues[RPCScheduler::priorityName(priority).toStdString()] = {
+                {"inflight",   scheduler->inFlight(priority)},
+                {"queued",     scheduler->queueDepth(priority)},
+                {"max_queued", scheduler->maxQueueDepth(priority)}
+            };
+        }
+    }
+
+    return {
+        {"since",   since.toString(Qt::ISODate).toStdString()},
+        {"now",     QDateTime::currentDateTime().toString(Qt::ISODate).toStdString()},
+        {"methods", methods},
+        {"queues",  queues}
+    };
+}
+
+
+/***********************************************************************************
+ *  RPCMetricsTableModel
+ ************************************************************************************/
+static QString formatBytes(qint64 bytes) {
+    if (bytes < 1024)
+        return QString::number(bytes) % " B";
+    if (bytes < 1024 * 1024)
+        return QString::number(bytes / 1024.0, 'f', 1) % " KB";
+
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) % " MB";
+}
+
+RPCMetricsTableModel::RPCMetricsTableModel(QObject* parent)
+     : QAbstractTableModel(parent) {
+    headers << tr("Method") << tr("Calls") << tr("Errors") << tr("Retries") << tr("In flight")
+            << tr("p50 (ms)") << tr("p95 (ms)") << tr("p99 (ms)") << tr("Sent") << tr("Received")
+            << tr("Queued") << tr("Max queued");
+}
+
+void RPCMetricsTableModel::setMetrics(const RPCMetrics* m) {
+    metrics = m;
+    refresh();
+}
+
+void RPCMetricsTableModel::refresh() {
+    beginResetModel();
+    methods = metrics ? metrics->methods() : QList<QString>();
+    endResetModel();
+}
+
+// A row for every method, followed by one for each of the scheduler's queues
+int RPCMetricsTableModel::rowCount(const QModelIndex&) const {
+    if (metrics == nullptr)
+        return 0;
+
+    return methods.size() + (metrics->getScheduler() ? RPCPriority::NumPriorities : 0);
+}
+
+int RPCMetricsTableModel::columnCount(const QModelIndex&) const {
+    return headers.size();
+}
+
+QVariant RPCMetricsTableModel::data(const QModelIndex &index, int role) const {
+    if (metrics == nullptr)
+        return QVariant();
+
+    if (role == Qt::TextAlignmentRole && index.column() > 0)
+        return QVariant(Qt::AlignRight | Qt::AlignVCenter);
+
+    if (role == Qt::DisplayRole && index.row() >= methods.size()) {
+        auto scheduler = metrics->getScheduler();
+        auto priority  = static_cast<RPCPriority>(index.row() - methods.size());
+
+        switch (index.column()) {
+            case 0:  return QString("queue:" % RPCScheduler::priorityName(priority));
+            case 4:  return scheduler->inFlight(priority);
+            case 10: return scheduler->queueDepth(priority);
+            case 11: return scheduler->maxQueueDepth(priority);
+        }
+
+        return QVariant();
+    }
+
+    if (role == Qt::DisplayRole) {
+        auto method = methods.at(index.row());
+        auto s = metrics->get(method);
+
+        switch (index.column()) {
+            case 0: return method;
+            case 1: return s.calls;
+            case 2: return s.errors;
+            case 3: return s.retries;
+            case 4: return s.inFlight;
+            case 5: return s.latency.percentile(0.50);
+            case 6: return s.latency.percentile(0.95);
+            case 7: return s.latency.percentile(0.99);
+            case 8: return formatBytes(s.bytesOut);
+            case 9: return formatBytes(s.bytesIn);
+        }
+    }
+
+    return QVariant();
+}
+
+QVariant RPCMetricsTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
+        return headers.at(section);
+    }
+
+    return QVariant();
+}
@@ -0,0 +1,103 @@
+#ifndef RPCMETRICS_H
+#define RPCMETRICS_H
+
+#include "precompiled.h"
+#include "rpcscheduler.h"
+
+using json = nlohmann::json;
+
+/**
+ * Latency histogram with fixed, roughly logarithmic buckets, so that percentiles can be
+ * estimated without keeping every sample around.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void    add(qint64 ms);
+
+    // Upper bound of the bucket holding the q-th quantile (0 < q <= 1), in ms
+    qint64  percentile(double q) const;
+
+    qint64  count() const { return total; }
+    qint64  max() const   { return maxMs; }
+    double  mean() const  { return total == 0 ? 0 : static_cast<double>(sumMs) / total; }
+
+private:
+    static const QVector<qint64>& bounds();
+
+    QVector<qint64> counts;
+    qint64          total   = 0;
+    qint64          sumMs   = 0;
+    qint64          maxMs   = 0;
+};
+
+struct RPCMethodStats {
+    qint64              calls       = 0;
+    qint64              errors      = 0;
+    qint64              timeouts    = 0;
+    qint64              cancelled   = 0;    // Dropped because a newer refresh started
+    qint64              retries     = 0;
+    qint64              coalesced   = 0;    // Joined an identical call that was already in flight
+    qint64              bytesOut    = 0;
+    qint64              bytesIn     = 0;
+    int                 inFlight    = 0;
+    LatencyHistogram    latency;
+};
+
+/**
+ * Per-method counters for the RPCs sent to ycashd: latency, bytes sent and received,
+ * errors and the number of calls currently on the wire. Batches are recorded under
+ * "batch:<method>". The depths of the scheduler's queues are reported along with them.
+ */
+class RPCMetrics {
+public:
+    void    started(const QString& method, qint64 bytesOut);
+    void    finished(const QString& method, qint64 elapsedMs, qint64 bytesIn, bool error);
+    void    timedOut(const QString& method)  { stats[method].timeouts++; }
+    void    cancelled(const QString& method) { stats[method].cancelled++; }
+    void    retried(const QString& method)   { stats[method].retries++; }
+    void    coalesced(const QString& method) { stats[method].coalesced++; }
+
+    QList<QString>          methods() const { return stats.keys(); }
+    RPCMethodStats          get(const QString& method) const { return stats.value(method); }
+
+    // One line per method, for the log file
+    QStringList             summary() const;
+    json                    toJson() const;
+
+    void                    reset() { stats.clear(); since = QDateTime::currentDateTime(); }
+
+    void                    setScheduler(const RPCScheduler* s) { scheduler = s; }
+    const RPCScheduler*     getScheduler() const { return scheduler; }
+
+private:
+    QMap<QString, RPCMethodStats>   stats;
+    QDateTime                       since       = QDateTime::currentDateTime();
+    const RPCScheduler*             scheduler   = nullptr;
+};
+
+/**
+ * Table of the RPC metrics, shown in the ycashd tab.
+ */
+class RPCMetricsTableModel : public QAbstractTableModel {
+
+public:
+    RPCMetricsTableModel(QObject* parent);
+    ~RPCMetricsTableModel() = default;
+
+    void     setMetrics(const RPCMetrics* m);
+    void     refresh();
+
+    int      rowCount(const QModelIndex &parent) const;
+    int      columnCount(const QModelIndex &parent) const;
+    QVariant data(const QModelIndex &index, int role) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+
+private:
+    const RPCMetrics*   metrics     = nullptr;
+    QList<QString>      methods;
+    QStringList         headers;
+};
+
+#endif // RPCMETRICS_H
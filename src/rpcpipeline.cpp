@@ -0,0 +1,321 @@
+#include "rpcpipeline.h"
+
+/***********************************************************************************
+ *  PipelinedReply
+ ************************************************************************************/
+PipelinedReply::PipelinedReply(const QNetworkRequest& request, QObject* parent)
+    : QNetworkReply(parent) {
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(QNetworkAccessManager::PostOperation);
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void PipelinedReply::abort() {
+    if (isFinished())
+        return;
+
+    // The request may already be on the wire. Its answer is thrown away when it arrives, so the
+    // other requests pipelined on the same connection aren't disturbed.
+    fail(QNetworkReply::OperationCanceledError, QObject::tr("Operation canceled"));
+}
+
+qint64 PipelinedReply::bytesAvailable() const {
+    return (content.size() - offset) + QIODevice::bytesAvailable();
+}
+
+qint64 PipelinedReply::readData(char* data, qint64 maxSize) {
+    qint64 n = std::min(maxSize, static_cast<qint64>(content.size()) - offset);
+    if (n <= 0)
+        return -1;
+
+    memcpy(data, content.constData() + offset, static_cast<size_t>(n));
+    offset += n;
+
+    return n;
+}
+
+void PipelinedReply::complete(int status, QByteArray body) {
+    content = std::move(body);
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, status);
+
+    // Same errors QNetworkAccessManager reports for these status codes. ycashd answers a failed
+    // RPC with a 500 and the JSON-RPC error in the body.
+    if (status >= 400) {
+        NetworkError code;
+        switch (status) {
+            case 401: code = QNetworkReply::AuthenticationRequiredError;        break;
+            case 403: code = QNetworkReply::ContentAccessDenied;                break;
+            case 404: code = QNetworkReply::ContentNotFoundError;               break;
+            case 405: code = QNetworkReply::ContentOperationNotPermittedError;  break;
+            case 500: code = QNetworkReply::InternalServerError;                break;
+            case 503: code = QNetworkReply::ServiceUnavailableError;            break;
+            default:  code = status < 500 ? QNetworkReply::UnknownContentError : QNetworkReply::UnknownServerError;
+        }
+        setError(code, QObject::tr("Error transferring %1 - server replied: %2").arg(url().toString()).arg(status));
+    }
+
+    setFinished(true);
+    emit metaDataChanged();
+    emit readyRead();
+    emit finished();
+}
+
+void PipelinedReply::fail(QNetworkReply::NetworkError code, const QString& message) {
+    setError(code, message);
+    setFinished(true);
+    emit finished();
+}
+
+
+/***********************************************************************************
+ *  RPCPipeline
+ ************************************************************************************/
+RPCPipeline::RPCPipeline(const QNetworkRequest& request, int maxConnections, QObject* parent)
+    : QObject(parent) {
+    this->request        = request;
+    this->host           = request.url().host();
+    this->port           = static_cast<quint16>(request.url().port(80));
+    this->maxConnections = std::max(1, maxConnections);
+
+    // Everything up to the body length is the same for every call, so build it once
+    head = "POST / HTTP/1.1\r\nHost: " % host.toUtf8() % ":" % QByteArray::number(port) % "\r\n";
+    for (auto& name : request.rawHeaderList()) {
+        head += name % ": " % request.rawHeader(name) % "\r\n";
+    }
+    if (!request.hasRawHeader("Content-Type")) {
+        head += "Content-Type: " % request.header(QNetworkRequest::ContentTypeHeader).toByteArray() % "\r\n";
+    }
+    head += "Connection: keep-alive\r\nContent-Length: ";
+}
+
+RPCPipeline::~RPCPipeline() {
+    for (auto link : links) {
+        delete link;
+    }
+}
+
+QNetworkReply* RPCPipeline::post(const QByteArray& body) {
+    auto reply = new PipelinedReply(request, this);
+    auto link  = pickLink();
+
+    QByteArray out;
+    out.reserve(head.size() + body.size() + 16);
+    out += head;
+    out += QByteArray::number(body.size());
+    out += "\r\n\r\n";
+    out += body;
+
+    // If the connection is still being set up, the socket holds on to this until it is connected
+    link->waiting.enqueue(reply);
+    link->socket->write(out);
+
+    return reply;
+}
+
+RPCPipeline::Link* RPCPipeline::pickLink() {
+    Link* best = nullptr;
+    for (auto link : links) {
+        if (best == nullptr || link->waiting.size() < best->waiting.size())
+            best = link;
+    }
+
+    // Only open another connection if every open one already has something in flight
+    if (best == nullptr || (!best->waiting.isEmpty() && links.size() < maxConnections))
+        return openLink();
+
+    return best;
+}
+
+RPCPipeline::Link* RPCPipeline::openLink() {
+    auto link = new Link();
+    link->socket = new QTcpSocket(this);
+    link->socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    link->socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+
+    QObject::connect(link->socket, &QTcpSocket::readyRead, [=] () {
+        link->in += link->socket->readAll();
+        while (links.contains(link) && readResponse(link))
+            ;
+    });
+
+    QObject::connect(link->socket, &QTcpSocket::disconnected, [=] () {
+        if (!links.contains(link))
+            return;
+
+        // A response without a length runs until ycashd closes the connection
+        if (link->haveHeaders && !link->chunked && link->contentLength < 0) {
+            finishResponse(link, link->in);
+        }
+
+        dropLink(link, QNetworkReply::RemoteHostClosedError, QObject::tr("Connection closed"));
+    });
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    QObject::connect(link->socket, &QAbstractSocket::errorOccurred, [=] (QAbstractSocket::SocketError err) {
+#else
+    QObject::connect(link->socket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error),
+                        [=] (QAbstractSocket::SocketError err) {
+#endif
+        if (!links.contains(link))
+            return;
+
+        // A clean close is handled when the socket reports it is disconnected
+        if (err == QAbstractSocket::RemoteHostClosedError)
+            return;
+
+        QNetworkReply::NetworkError code;
+        switch (err) {
+            case QAbstractSocket::ConnectionRefusedError:   code = QNetworkReply::ConnectionRefusedError;   break;
+            case QAbstractSocket::HostNotFoundError:        code = QNetworkReply::HostNotFoundError;        break;
+            case QAbstractSocket::SocketTimeoutError:       code = QNetworkReply::TimeoutError;             break;
+            default:                                        code = QNetworkReply::UnknownNetworkError;
+        }
+        dropLink(link, code, link->socket->errorString());
+    });
+
+    link->socket->connectToHost(host, port);
+    links.append(link);
+
+    return link;
+}
+
+/**
+ * Read one response off the front of the link's input. Returns false if it hasn't fully arrived yet.
+ */
+bool RPCPipeline::readResponse(Link* link) {
+    if (!link->haveHeaders) {
+        int end = link->in.indexOf("\r\n\r\n");
+        if (end < 0)
+            return false;
+
+        auto lines = link->in.left(end).split('\n');
+
+        // HTTP/1.1 200 OK
+        auto statusLine = lines.first().trimmed().split(' ');
+        bool ok = false;
+        link->status = statusLine.size() > 1 && statusLine[0].startsWith("HTTP/") ? statusLine[1].toInt(&ok) : 0;
+        if (!ok) {
+            dropLink(link, QNetworkReply::ProtocolFailure, QObject::tr("Invalid response from ycashd"));
+            return false;
+        }
+
+        link->contentLength = -1;
+        link->chunked       = false;
+        link->closeAfter    = false;
+        for (int i = 1; i < lines.size(); i++) {
+            int colon = lines[i].indexOf(':');
+            if (colon < 0)
+                continue;
+
+            auto name  = lines[i].left(colon).trimmed().toLower();
+            auto value = lines[i].mid(colon + 1).trimmed().toLower();
+            if (name == "content-length") {
+                link->contentLength = value.toLongLong();
+            } else if (name == "transfer-encoding") {
+                link->chunked = value.contains("chunked");
+            } else if (name == "connection") {
+                link->closeAfter = value == "close";
+            }
+        }
+
+        link->in.remove(0, end + 4);
+        link->haveHeaders = true;
+    }
+
+    if (link->chunked) {
+        forever {
+            int eol = link->in.indexOf("\r\n");
+            if (eol < 0)
+                return false;
+
+            bool ok = false;
+            qint64 size = link->in.left(eol).split(';').first().trimmed().toLongLong(&ok, 16);
+            if (!ok) {
+                dropLink(link, QNetworkReply::ProtocolFailure, QObject::tr("Invalid chunk from ycashd"));
+                return false;
+            }
+
+            if (size == 0) {
+                // The last chunk. ycashd doesn't send trailers, so skip to the empty line that ends it.
+                int end = link->in.indexOf("\r\n\r\n", eol);
+                if (end < 0)
+                    return false;
+
+                link->in.remove(0, end + 4);
+                break;
+            }
+
+            if (link->in.size() < eol + 2 + size + 2)
+                return false;
+
+            link->chunkedBody.append(link->in.constData() + eol + 2, static_cast<int>(size));
+            link->in.remove(0, static_cast<int>(eol + 2 + size + 2));
+        }
+
+        QByteArray body = std::move(link->chunkedBody);
+        link->chunkedBody = QByteArray();
+        finishResponse(link, std::move(body));
+        return true;
+    }
+
+    if (link->contentLength < 0)
+        return false;
+
+    if (link->in.size() < link->contentLength)
+        return false;
+
+    QByteArray body;
+    if (link->in.size() == link->contentLength) {
+        // The usual case, when nothing else has arrived behind this response yet
+        body = std::move(link->in);
+        link->in = QByteArray();
+    } else {
+        body = link->in.left(static_cast<int>(link->contentLength));
+        link->in.remove(0, static_cast<int>(link->contentLength));
+    }
+
+    finishResponse(link, std::move(body));
+    return true;
+}
+
+void RPCPipeline::finishResponse(Link* link, QByteArray body) {
+    link->haveHeaders = false;
+
+    if (link->waiting.isEmpty()) {
+        dropLink(link, QNetworkReply::ProtocolFailure, QObject::tr("Unexpected response from ycashd"));
+        return;
+    }
+
+    // Calls that were aborted or deleted while waiting just have their answer dropped
+    QPointer<PipelinedReply> reply = link->waiting.dequeue();
+    bool closeAfter = link->closeAfter;
+
+    if (reply && !reply->isFinished())
+        reply->complete(link->status, std::move(body));
+
+    // Anything still waiting on this connection fails once it closes
+    if (closeAfter && links.contains(link))
+        link->socket->disconnectFromHost();
+}
+
+/**
+ * Close a connection and fail all the calls still waiting on it.
+ */
+void RPCPipeline::dropLink(Link* link, QNetworkReply::NetworkError code, const QString& message) {
+    if (!links.removeOne(link))
+        return;
+
+    auto waiting = link->waiting;
+    link->waiting.clear();
+
+    link->socket->disconnect();
+    link->socket->abort();
+    link->socket->deleteLater();
+    delete link;
+
+    for (auto& reply : waiting) {
+        if (reply && !reply->isFinished())
+            reply->fail(code, message);
+    }
+}
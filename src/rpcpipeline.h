@@ -0,0 +1,78 @@
+#ifndef RPCPIPELINE_H
+#define RPCPIPELINE_H
+
+#include "precompiled.h"
+
+/**
+ * Reply to a call sent through an RPCPipeline. It behaves like the QNetworkReply that
+ * QNetworkAccessManager hands back, so callers don't need to know which transport was used.
+ */
+class PipelinedReply : public QNetworkReply {
+    Q_OBJECT
+
+public:
+    PipelinedReply(const QNetworkRequest& request, QObject* parent);
+
+    void    abort() override;
+    qint64  bytesAvailable() const override;
+    bool    isSequential() const override { return true; }
+
+protected:
+    qint64  readData(char* data, qint64 maxSize) override;
+
+private:
+    friend class RPCPipeline;
+
+    void    complete(int status, QByteArray body);
+    void    fail(QNetworkReply::NetworkError code, const QString& message);
+
+    QByteArray  content;
+    qint64      offset  = 0;
+};
+
+/**
+ * A small HTTP/1.1 client for the ycashd RPC port, used instead of QNetworkAccessManager when
+ * Settings::getUsePipelinedRPC() is on. It keeps a few connections to ycashd open and writes
+ * requests back to back on them, without waiting for the answer to the previous one. ycashd
+ * answers the requests on a connection in the order they were sent, so each answer goes to
+ * the oldest request still waiting on that connection.
+ */
+class RPCPipeline : public QObject {
+public:
+    RPCPipeline(const QNetworkRequest& request, int maxConnections, QObject* parent = nullptr);
+    ~RPCPipeline();
+
+    // Send a JSON-RPC body. The reply is owned by the pipeline, but callers may delete it earlier.
+    QNetworkReply* post(const QByteArray& body);
+
+private:
+    // An open connection to ycashd, and the requests written to it that haven't been answered yet
+    struct Link {
+        QTcpSocket*                         socket;
+        QQueue<QPointer<PipelinedReply>>    waiting;
+        QByteArray                          in;
+
+        // The response being read
+        bool                                haveHeaders     = false;
+        int                                 status          = 0;
+        qint64                              contentLength   = -1;
+        bool                                chunked         = false;
+        bool                                closeAfter      = false;
+        QByteArray                          chunkedBody;
+    };
+
+    Link*   pickLink();
+    Link*   openLink();
+    bool    readResponse(Link* link);
+    void    finishResponse(Link* link, QByteArray body);
+    void    dropLink(Link* link, QNetworkReply::NetworkError code, const QString& message);
+
+    QNetworkRequest     request;
+    QString             host;
+    quint16             port;
+    QByteArray          head;           // Request line and headers, up to the Content-Length value
+    int                 maxConnections;
+    QList<Link*>        links;
+};
+
+#endif // RPCPIPELINE_H
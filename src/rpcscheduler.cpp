@@ -0,0 +1,98 @@
+#include "rpcscheduler.h"
+
+// How many Balance jobs may start in a row while Background jobs are waiting
+static const int balanceWeight = 4;
+
+RPCScheduler::RPCScheduler(int max) {
+    maxInFlight = std::max(1, max);
+}
+
+
+RPCPriority RPCScheduler::priorityForMethod(const QString& method) {
+    static const QSet<QString> interactive = {
+        "z_sendmany", "z_getoperationstatus", "validateaddress", "z_validateaddress",
+        "z_getnewaddress", "getnewaddress", "z_exportkey", "dumpprivkey", "z_exportviewingkey",
+        "z_importkey", "importprivkey", "z_importviewingkey", "z_importivk",
+        "z_setmigration", "rescanblockchain", "stop"
+    };
+
+    static const QSet<QString> balance = {
+        "getinfo", "getblockchaininfo", "getrescaninfo", "getnetworksolps",
+        "z_gettotalbalance", "listunspent", "z_listunspent",
+        "z_listaddresses", "getaddressesbyaccount", "z_getmigrationstatus"
+    };
+
+    if (interactive.contains(method))
+        return RPCPriority::Interactive;
+    if (balance.contains(method))
+        return RPCPriority::Balance;
+
+    return RPCPriority::Background;
+}
+
+QString RPCScheduler::priorityName(RPCPriority priority) {
+    switch (priority) {
+        case RPCPriority::Interactive:  return "interactive";
+        case RPCPriority::Balance:      return "balance";
+        default:                        return "background";
+    }
+}
+
+void RPCScheduler::submit(RPCPriority priority, const Job& job) {
+    queues[priority].enqueue(job);
+    maxDepth[priority] = std::max(maxDepth[priority], queues[priority].size());
+
+    dispatch();
+}
+
+/**
+ * Pick the queue to start the next job from, or -1 if nothing can be started right now.
+ */
+int RPCScheduler::nextQueue() {
+    if (!queues[RPCPriority::Interactive].isEmpty())
+        return RPCPriority::Interactive;
+
+    // The last slot is reserved for interactive calls
+    if (running >= maxInFlight - 1 && maxInFlight > 1)
+        return -1;
+
+    bool haveBalance    = !queues[RPCPriority::Balance].isEmpty();
+    bool haveBackground = !queues[RPCPriority::Background].isEmpty();
+
+    if (haveBalance && (!haveBackground || balanceStreak < balanceWeight)) {
+        if (haveBackground)
+            balanceStreak++;
+        return RPCPriority::Balance;
+    }
+
+    if (haveBackground) {
+        balanceStreak = 0;
+        return RPCPriority::Background;
+    }
+
+    return -1;
+}
+
+void RPCScheduler::dispatch() {
+    while (running < maxInFlight) {
+        int q = nextQueue();
+        if (q < 0)
+            return;
+
+        Job job = queues[q].dequeue();
+        running++;
+        runningBy[q]++;
+
+        // Guard against a job calling done more than once
+        auto finished = std::make_shared<bool>(false);
+        job([=] () {
+            if (*finished)
+                return;
+            *finished = true;
+
+            running--;
+            runningBy[q]--;
+            dispatch();
+        });
+    }
+}
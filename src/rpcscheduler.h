@@ -0,0 +1,56 @@
+#ifndef RPCSCHEDULER_H
+#define RPCSCHEDULER_H
+
+#include "precompiled.h"
+
+// Priority classes for RPCs sent to ycashd, most urgent first.
+enum RPCPriority {
+    Interactive = 0,    // Sends, validations and other calls the user is waiting on
+    Balance,            // Balances, UTXOs and node status
+    Background,         // Transaction history and key exports
+    NumPriorities
+};
+
+/**
+ * Orders the RPCs sent to ycashd and limits how many of them are in flight at once, so that
+ * a user's z_sendmany doesn't queue behind thousands of background history calls.
+ * Interactive calls always go first, and one slot is kept free for them. The other two classes
+ * share the remaining slots in weighted round-robin, so history still makes progress
+ * while balances are being refreshed.
+ */
+class RPCScheduler {
+public:
+    RPCScheduler(int maxInFlight);
+
+    // A job starts one request, and must call the done function it is given exactly once,
+    // when that request has finished.
+    typedef std::function<void(std::function<void(void)>)> Job;
+
+    void submit(RPCPriority priority, const Job& job);
+
+    int  queueDepth(RPCPriority priority) const { return queues[priority].size(); }
+    int  maxQueueDepth(RPCPriority priority) const { return maxDepth[priority]; }
+    int  inFlight() const { return running; }
+    int  inFlight(RPCPriority priority) const { return runningBy[priority]; }
+
+    int  getMaxInFlight() const { return maxInFlight; }
+
+    static RPCPriority priorityForMethod(const QString& method);
+    static QString     priorityName(RPCPriority priority);
+
+private:
+    void dispatch();
+    int  nextQueue();
+
+    QQueue<Job>     queues[NumPriorities];
+    int             maxDepth[NumPriorities]     = { 0, 0, 0 };
+
+    // Consecutive Balance jobs started while Background jobs were waiting
+    int             balanceStreak               = 0;
+
+    int             running                     = 0;
+    int             runningBy[NumPriorities]    = { 0, 0, 0 };
+    int             maxInFlight;
+};
+
+#endif // RPCSCHEDULER_H
@@ -0,0 +1,298 @@
+#!/usr/bin/env python3
+"""
+A minimal stand-in for ycashd's JSON-RPC port, for trying out YecWallet's RPC code without a node.
+
+It answers the calls YecWallet makes with a made up wallet, over HTTP/1.1 with keep-alive, and takes
+JSON-RPC batch arrays. Requests on one connection are answered in the order they came in, like
+ycashd does, so it can also be used with the pipelined transport.
+
+Failover between several ycashds can be tried with a few instances on different ports:
+
+    ./mockycashd.py --port 18232 &
+    ./mockycashd.py --port 18233 &
+    ./mockycashd.py --port 18234 --latency 50 &
+    yecwallet --no-embedded --replica 127.0.0.1:18233 --replica 127.0.0.1:18234
+
+with rpcport=18232, rpcuser=mock and rpcpassword=mock in ycash.conf. Sending SIGUSR1 to an instance
+takes it down (connections are refused) or brings it back up, e.g. kill -USR1 %1 for the primary.
+
+--blocks-every makes a new block every few seconds, and --work-queue turns requests away with
+"Work queue depth exceeded" when more than that many are being answered at once.
+"""
+
+import argparse
+import base64
+import hashlib
+import json
+import signal
+import socketserver
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler
+
+
+class Wallet:
+    """Made up, but consistent, wallet and chain state."""
+
+    def __init__(self, args):
+        self.lock    = threading.Lock()
+        self.height  = args.height
+        self.taddrs  = ["s1mock%030d" % i for i in range(args.taddrs)]
+        self.zaddrs  = ["ys1mock%070d" % i for i in range(args.zaddrs)]
+        self.txs     = []
+
+        # Every tx pays one of the addresses, and was mined a few blocks apart going back from the tip
+        for i in range(args.txs):
+            self.txs.append({
+                "txid":     self.hash("tx", i),
+                "address":  self.taddrs[i % len(self.taddrs)] if self.taddrs else "",
+                "zaddress": self.zaddrs[i % len(self.zaddrs)] if self.zaddrs else "",
+                "amount":   round(0.001 * (i % 1000 + 1), 8),
+                "height":   max(1, self.height - 3 * (args.txs - i)),
+                "vout":     i % 2,
+            })
+
+    @staticmethod
+    def hash(kind, n):
+        return hashlib.sha256(("%s:%d" % (kind, n)).encode()).hexdigest()
+
+    def block_hash(self, height):
+        return self.hash("block", height)
+
+    def new_block(self):
+        with self.lock:
+            self.height += 1
+
+    def confirmations(self, tx):
+        return self.height - tx["height"] + 1
+
+    def tx_entry(self, tx):
+        return {
+            "account":       "",
+            "address":       tx["address"],
+            "category":      "receive",
+            "amount":        tx["amount"],
+            "vout":          tx["vout"],
+            "confirmations": self.confirmations(tx),
+            "blockhash":     self.block_hash(tx["height"]),
+            "blocktime":     1500000000 + tx["height"] * 150,
+            "txid":          tx["txid"],
+            "time":          1500000000 + tx["height"] * 150,
+        }
+
+    def tx_by_id(self, txid):
+        for tx in self.txs:
+            if tx["txid"] == txid:
+                return tx
+        return None
+
+
+class RPCError(Exception):
+    def __init__(self, code, message):
+        self.code    = code
+        self.message = message
+
+
+def handle_call(wallet, method, params):
+    w = wallet
+    if method == "getinfo":
+        return {"version": 2000552, "blocks": w.height, "connections": 8, "testnet": False}
+    if method == "getblockchaininfo":
+        return {"blocks": w.height, "verificationprogress": 1.0, "estimatedheight": w.height}
+    if method == "getnetworksolps":
+        return 123456
+    if method == "getrescaninfo":
+        return {"rescanning": False}
+    if method == "getbestblockhash":
+        return w.block_hash(w.height)
+    if method == "getblockhash":
+        if params[0] > w.height:
+            raise RPCError(-8, "Block height out of range")
+        return w.block_hash(params[0])
+    if method == "getblockheader":
+        for height in range(w.height, 0, -1):
+            if w.block_hash(height) == params[0]:
+                return {"hash": params[0], "height": height, "confirmations": w.height - height + 1}
+        raise RPCError(-5, "Block not found")
+    if method == "z_listaddresses":
+        return w.zaddrs
+    if method == "getaddressesbyaccount":
+        return w.taddrs
+    if method == "listunspent":
+        return [{"txid": tx["txid"], "vout": tx["vout"], "address": tx["address"], "amount": tx["amount"],
+                 "confirmations": w.confirmations(tx), "spendable": True} for tx in w.txs if tx["address"]]
+    if method == "z_listunspent":
+        return [{"txid": tx["txid"], "outindex": tx["vout"], "address": tx["zaddress"], "amount": tx["amount"],
+                 "confirmations": w.confirmations(tx), "spendable": True} for tx in w.txs if tx["zaddress"]]
+    if method == "listtransactions":
+        count = params[1] if len(params) > 1 else 10
+        skip  = params[2] if len(params) > 2 else 0
+        # Newest last, like ycashd, and paged from the newest end
+        entries = [w.tx_entry(tx) for tx in w.txs]
+        end     = max(0, len(entries) - skip)
+        return entries[max(0, end - count):end]
+    if method == "listsinceblock":
+        since = 0
+        for height in range(w.height, 0, -1):
+            if w.block_hash(height) == params[0]:
+                since = height
+                break
+        return {"transactions": [w.tx_entry(tx) for tx in w.txs if tx["height"] > since],
+                "lastblock": w.block_hash(w.height)}
+    if method == "gettransaction":
+        tx = w.tx_by_id(params[0])
+        if tx is None:
+            raise RPCError(-5, "Invalid or non-wallet transaction id")
+        return w.tx_entry(tx)
+    if method == "z_listreceivedbyaddress":
+        return [{"txid": tx["txid"], "amount": tx["amount"], "memo": "f6" + "00" * 511, "outindex": tx["vout"],
+                 "change": False} for tx in w.txs if tx["zaddress"] == params[0]]
+    if method == "z_getoperationstatus":
+        return []
+    if method == "z_getmigrationstatus":
+        return {"enabled": False, "destination_address": w.zaddrs[0] if w.zaddrs else "",
+                "unmigrated_amount": "0.00", "unfinalized_migrated_amount": "0.00",
+                "finalized_migrated_amount": "0.00", "finalized_migration_transactions": 0,
+                "migration_txids": []}
+    if method in ("dumpprivkey", "z_exportkey", "z_exportviewingkey", "z_exportivk"):
+        return "%s-%s" % (method, w.hash(method + params[0], 0)[:32])
+    if method in ("validateaddress", "z_validateaddress"):
+        return {"isvalid": params[0] in w.taddrs or params[0] in w.zaddrs, "address": params[0]}
+
+    raise RPCError(-32601, "Method not found")
+
+
+def answer(wallet, call):
+    response = {"id": call.get("id") if isinstance(call, dict) else None, "result": None, "error": None}
+    try:
+        if not isinstance(call, dict) or "method" not in call:
+            raise RPCError(-32600, "Invalid Request object")
+        response["result"] = handle_call(wallet, call["method"], call.get("params", []))
+    except RPCError as e:
+        response["error"] = {"code": e.code, "message": e.message}
+    except (IndexError, KeyError, TypeError):
+        response["error"] = {"code": -1, "message": "Invalid params"}
+    return response
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        if self.server.verbose:
+            sys.stderr.write("%s %s\n" % (self.server.server_address[1], fmt % args))
+
+    def reply(self, status, body, content_type="application/json"):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_POST(self):
+        server = self.server
+        length = int(self.headers.get("Content-Length", 0))
+        body   = self.rfile.read(length)
+
+        if self.headers.get("Authorization") != server.auth:
+            self.reply(401, b"", "text/plain")
+            return
+
+        with server.busy_lock:
+            server.busy += 1
+            full = server.work_queue > 0 and server.busy > server.work_queue
+        try:
+            if full:
+                self.reply(500, b"Work queue depth exceeded", "text/plain")
+                return
+
+            if server.latency > 0:
+                time.sleep(server.latency / 1000.0)
+
+            try:
+                request = json.loads(body)
+            except ValueError:
+                self.reply(500, json.dumps({"id": None, "result": None,
+                                            "error": {"code": -32700, "message": "Parse error"}}).encode())
+                return
+
+            if isinstance(request, list):
+                response = [answer(server.wallet, call) for call in request]
+                status   = 200
+            else:
+                response = answer(server.wallet, request)
+                # ycashd answers a failed single call with an HTTP error
+                status   = 200 if response["error"] is None else (404 if response["error"]["code"] == -32601 else 500)
+
+            self.reply(status, json.dumps(response).encode())
+        finally:
+            with server.busy_lock:
+                server.busy -= 1
+
+
+class MockServer(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    allow_reuse_address = True
+    daemon_threads      = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Minimal mock ycashd RPC server")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=18232)
+    parser.add_argument("--rpcuser", default="mock")
+    parser.add_argument("--rpcpassword", default="mock")
+    parser.add_argument("--latency", type=float, default=0, help="ms added to every request")
+    parser.add_argument("--height", type=int, default=1000000)
+    parser.add_argument("--taddrs", type=int, default=5)
+    parser.add_argument("--zaddrs", type=int, default=5)
+    parser.add_argument("--txs", type=int, default=200)
+    parser.add_argument("--blocks-every", type=float, default=0, help="seconds between new blocks")
+    parser.add_argument("--work-queue", type=int, default=0, help="requests answered at once before turning more away")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    wallet = Wallet(args)
+    auth   = "Basic " + base64.b64encode(("%s:%s" % (args.rpcuser, args.rpcpassword)).encode()).decode()
+
+    state = {"server": None, "thread": None}
+
+    def start():
+        server = MockServer((args.host, args.port), Handler)
+        server.wallet, server.auth, server.verbose = wallet, auth, args.verbose
+        server.latency, server.work_queue          = args.latency, args.work_queue
+        server.busy, server.busy_lock              = 0, threading.Lock()
+
+        thread = threading.Thread(target=server.serve_forever, daemon=True)
+        thread.start()
+        state["server"], state["thread"] = server, thread
+        print("mockycashd listening on %s:%d at height %d" % (args.host, args.port, wallet.height), flush=True)
+
+    def stop():
+        server = state["server"]
+        state["server"] = None
+        server.shutdown()
+        server.server_close()
+        print("mockycashd on port %d is down" % args.port, flush=True)
+
+    # Toggling from a thread, since shutdown() waits for serve_forever to return
+    def toggle(signum, frame):
+        threading.Thread(target=stop if state["server"] else start, daemon=True).start()
+
+    if hasattr(signal, "SIGUSR1"):
+        signal.signal(signal.SIGUSR1, toggle)
+
+    start()
+    try:
+        while True:
+            if args.blocks_every > 0:
+                time.sleep(args.blocks_every)
+                wallet.new_block()
+            else:
+                time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
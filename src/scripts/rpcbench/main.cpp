@@ -0,0 +1,161 @@
+/**
+ * Benchmark for the ycashd RPC transports. It sends the same calls through QNetworkAccessManager,
+ * which is what Connection uses by default, and through RPCPipeline, which it uses when
+ * Settings::getUsePipelinedRPC() is on, and prints how long each took.
+ *
+ * It is meant to be run against src/scripts/mockycashd.py, so the numbers only depend on the
+ * transport and the latency the mock is told to add:
+ *
+ *     ../mockycashd.py --port 18232 --latency 20 &
+ *     qmake rpcbench.pro && make
+ *     ./rpcbench --port 18232 --calls 1000 --inflight 50
+ *
+ * It can be pointed at a real ycashd with --user and --password as well. Calls are kept
+ * --inflight at a time, the way a refresh fans out gettransaction and z_listreceivedbyaddress.
+ */
+#include "precompiled.h"
+
+#include "rpcpipeline.h"
+
+struct Result {
+    qint64          totalMs     = 0;
+    int             errors      = 0;
+    QList<qint64>   latenciesUs;
+};
+
+/**
+ * Send calls through post(), keeping inflight of them going until all have been answered.
+ */
+static Result run(const std::function<QNetworkReply*(const QByteArray&)>& post,
+                    const QByteArray& body, int calls, int inflight) {
+    Result result;
+    QEventLoop loop;
+    QElapsedTimer total;
+    int sent = 0, answered = 0;
+
+    std::function<void(void)> sendNext = [&] () {
+        auto reply = post(body);
+        sent++;
+
+        QElapsedTimer timer;
+        timer.start();
+        QObject::connect(reply, &QNetworkReply::finished, [&, reply, timer] () {
+            result.latenciesUs.append(timer.nsecsElapsed() / 1000);
+            if (reply->error() != QNetworkReply::NoError)
+                result.errors++;
+
+            reply->readAll();
+            reply->deleteLater();
+
+            answered++;
+            if (sent < calls) {
+                sendNext();
+            } else if (answered == calls) {
+                loop.quit();
+            }
+        });
+    };
+
+    total.start();
+    for (int i = 0; i < std::min(inflight, calls); i++) {
+        sendNext();
+    }
+    loop.exec();
+    result.totalMs = total.elapsed();
+
+    std::sort(result.latenciesUs.begin(), result.latenciesUs.end());
+    return result;
+}
+
+static void print(const QString& name, const QList<Result>& rounds) {
+    // The best round, so a stray slow round on a busy machine doesn't hide the difference
+    auto best = *std::min_element(rounds.begin(), rounds.end(), [] (const Result& a, const Result& b) {
+        return a.totalMs < b.totalMs;
+    });
+
+    auto percentile = [&] (int p) {
+        return best.latenciesUs.isEmpty() ? 0.0 :
+                best.latenciesUs[(best.latenciesUs.size() - 1) * p / 100] / 1000.0;
+    };
+
+    qint64 errors = 0;
+    for (auto& r : rounds) {
+        errors += r.errors;
+    }
+
+    std::cout << std::left << std::setw(24) << name.toStdString() << std::right
+              << std::setw(10) << best.totalMs << " ms"
+              << std::setw(10) << std::fixed << std::setprecision(0)
+              << (best.latenciesUs.size() * 1000.0 / std::max<qint64>(1, best.totalMs)) << " calls/s"
+              << std::setw(10) << std::setprecision(2) << percentile(50) << " ms p50"
+              << std::setw(10) << percentile(95) << " ms p95"
+              << std::setw(8) << errors << " errors" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares the pipelined RPC transport with QNetworkAccessManager");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("host",     "ycashd host", "host", "127.0.0.1"));
+    parser.addOption(QCommandLineOption("port",     "ycashd RPC port", "port", "18232"));
+    parser.addOption(QCommandLineOption("user",     "rpcuser", "user", "mock"));
+    parser.addOption(QCommandLineOption("password", "rpcpassword", "password", "mock"));
+    parser.addOption(QCommandLineOption("method",   "RPC method to call, without params", "method", "getinfo"));
+    parser.addOption(QCommandLineOption("calls",    "Calls per round", "n", "1000"));
+    parser.addOption(QCommandLineOption("inflight", "Calls in flight at once", "n", "50"));
+    parser.addOption(QCommandLineOption("rounds",   "Rounds per transport", "n", "5"));
+    parser.addOption(QCommandLineOption("connections", "Connections the pipeline may open", "n", "2"));
+    parser.process(app);
+
+    int calls       = std::max(1, parser.value("calls").toInt());
+    int inflight    = std::max(1, parser.value("inflight").toInt());
+    int rounds      = std::max(1, parser.value("rounds").toInt());
+    int connections = std::max(1, parser.value("connections").toInt());
+
+    // Same request Connection sends, see ConnectionLoader::makeRequest()
+    QUrl url;
+    url.setScheme("http");
+    url.setHost(parser.value("host"));
+    url.setPort(parser.value("port").toInt());
+
+    QNetworkRequest request;
+    request.setUrl(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/plain");
+
+    QString userpass = parser.value("user") % ":" % parser.value("password");
+    request.setRawHeader("Authorization", "Basic " + userpass.toLocal8Bit().toBase64());
+
+    QByteArray body = "{\"jsonrpc\":\"1.0\",\"id\":\"someid\",\"method\":\""
+                        % parser.value("method").toUtf8() % "\",\"params\":[]}";
+
+    QNetworkAccessManager manager;
+    RPCPipeline pipeline(request, connections);
+
+    auto viaManager  = [&] (const QByteArray& b) { return manager.post(request, b); };
+    auto viaPipeline = [&] (const QByteArray& b) { return pipeline.post(b); };
+
+    // Open the connections and check ycashd answers before timing anything
+    auto warmup = run(viaManager, body, inflight, inflight);
+    run(viaPipeline, body, inflight, inflight);
+    if (warmup.errors == inflight) {
+        std::cerr << "Couldn't call " << parser.value("method").toStdString() << " on "
+                  << url.toString().toStdString() << std::endl;
+        return 1;
+    }
+
+    // Take turns, so both see the same conditions on the machine
+    QList<Result> managerRounds, pipelineRounds;
+    for (int i = 0; i < rounds; i++) {
+        managerRounds.append(run(viaManager, body, calls, inflight));
+        pipelineRounds.append(run(viaPipeline, body, calls, inflight));
+    }
+
+    std::cout << calls << " x " << parser.value("method").toStdString() << ", " << inflight
+              << " in flight, best of " << rounds << " rounds" << std::endl;
+    print("QNetworkAccessManager", managerRounds);
+    print(QString("RPCPipeline (%1 conn)").arg(connections), pipelineRounds);
+
+    return 0;
+}
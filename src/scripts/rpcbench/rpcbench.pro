@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Compares the pipelined RPC transport with QNetworkAccessManager.
+# See the comment at the top of main.cpp for how to run it.
+#
+#-------------------------------------------------
+
+QT       += core gui network concurrent
+
+QT += widgets
+
+TARGET = rpcbench
+
+TEMPLATE = app
+
+CONFIG += console c++14
+CONFIG -= app_bundle
+
+DEFINES += \
+    QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH  += ../../3rdparty/
+INCLUDEPATH  += ../../
+
+SOURCES += \
+    main.cpp \
+    ../../rpcpipeline.cpp
+
+HEADERS += \
+    ../../rpcpipeline.h
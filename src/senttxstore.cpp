@@ -49,6 +49,7 @@ QList<TransactionItem> SentTxStore::readSentTxFile() {
                           sentTx["txid"].toString(), 
                           sentTx["amount"].toDouble() + sentTx["fee"].toDouble(), 
                           0, sentTx["from"].toString(), memo};
+        t.height = sentTx["height"].toInt();    // Missing until it is mined
         items.push_back(t);
     }
 
@@ -122,3 +123,34 @@ void SentTxStore::addToSentTx(Tx tx, QString txid) {
     } 
     writer.close();
 }
+
+void SentTxStore::setMinedHeights(const QMap<QString, int>& heights) {
+    if (heights.isEmpty() || !Settings::getInstance()->getSaveZtxs())
+        return;
+
+    QFile data(writeableFile());
+    if (!data.open(QFile::ReadOnly))
+        return;
+
+    auto jsonDoc = QJsonDocument::fromJson(data.readAll());
+    data.close();
+
+    auto list = jsonDoc.array();
+    for (int i = 0; i < list.size(); i++) {
+        auto sentTx = list[i].toObject();
+        auto txid   = sentTx["txid"].toString();
+        if (!heights.contains(txid))
+            continue;
+
+        sentTx["height"] = heights[txid];
+        list[i] = sentTx;
+    }
+
+    jsonDoc.setArray(list);
+
+    QFile writer(writeableFile());
+    if (writer.open(QFile::WriteOnly | QFile::Truncate)) {
+        writer.write(jsonDoc.toJson());
+    } 
+    writer.close();
+}
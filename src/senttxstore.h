@@ -12,6 +12,9 @@ public:
     static QList<TransactionItem> readSentTxFile();
     static void                   addToSentTx(Tx tx, QString txid);
 
+    // Remember the blocks sent txs were mined in, so they don't have to be looked up again
+    static void                   setMinedHeights(const QMap<QString, int>& heights);
+
 private:
     static QString writeableFile();
     
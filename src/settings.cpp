@@ -132,6 +132,51 @@ void Settings::setCheckForUpdates(bool allow) {
      QSettings().setValue("options/allowcheckupdates", allow);
 }
 
+int Settings::getTxCacheDepth() {
+    // Confirmations a tx needs before its gettransaction details are cached on disk
+    return QSettings().value("options/txcachedepth", Settings::settledConfirmations).toInt();
+}
+
+void Settings::setTxCacheDepth(int confirmations) {
+    QSettings().setValue("options/txcachedepth", confirmations);
+}
+
+int Settings::getRPCBatchSize() {
+    // Number of calls packed into a single JSON-RPC batch request
+    return QSettings().value("connection/rpcbatchsize", 100).toInt();
+}
+
+void Settings::setRPCBatchSize(int size) {
+    QSettings().setValue("connection/rpcbatchsize", size);
+}
+
+int Settings::getMaxRPCsInFlight() {
+    // Defaults to ycashd's default number of RPC worker threads
+    return QSettings().value("connection/maxinflight", 4).toInt();
+}
+
+void Settings::setMaxRPCsInFlight(int max) {
+    QSettings().setValue("connection/maxinflight", max);
+}
+
+bool Settings::getUsePipelinedRPC() {
+    return QSettings().value("connection/pipelinedrpc", false).toBool();
+}
+
+void Settings::setUsePipelinedRPC(bool use) {
+    QSettings().setValue("connection/pipelinedrpc", use);
+}
+
+QStringList Settings::getReplicaEndpoints() {
+    auto endpoints = QSettings().value("connection/replicas").toStringList() + _cmdLineReplicas;
+    endpoints.removeDuplicates();
+    return endpoints;
+}
+
+void Settings::setReplicaEndpoints(const QStringList& endpoints) {
+    QSettings().setValue("connection/replicas", endpoints);
+}
+
 bool Settings::getAllowFetchPrices() {
     return QSettings().value("options/allowfetchprices", true).toBool();
 }
@@ -282,6 +327,25 @@ bool Settings::addToZcashConf(QString confLocation, QString line) {
     return true;
 }
 
+bool Settings::isInZcashConf(QString confLocation, QString option) {
+    if (confLocation.isEmpty())
+        return false;
+
+    QFile file(confLocation);
+    if (!file.open(QIODevice::ReadOnly)) 
+        return false;
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        auto s = line.indexOf("=");
+        if (line.left(s).trimmed().toLower() == option)
+            return true;
+    }
+
+    return false;
+}
+
 bool Settings::removeFromZcashConf(QString confLocation, QString option) {
     if (confLocation.isEmpty())
         return false;
@@ -71,6 +71,24 @@ public:
     bool    getCheckForUpdates();
     void    setCheckForUpdates(bool allow);
 
+    int     getTxCacheDepth();
+    void    setTxCacheDepth(int confirmations);
+
+    int     getRPCBatchSize();
+    void    setRPCBatchSize(int size);
+
+    int     getMaxRPCsInFlight();
+    void    setMaxRPCsInFlight(int max);
+
+    // Send RPCs over a few kept-alive, pipelined connections instead of through QNetworkAccessManager
+    bool    getUsePipelinedRPC();
+    void    setUsePipelinedRPC(bool use);
+
+    // Extra ycashd endpoints that read-only calls can be sent to, as [user:password@]host:port
+    QStringList getReplicaEndpoints();
+    void        setReplicaEndpoints(const QStringList& endpoints);
+    void        addCommandLineReplica(const QString& endpoint) { _cmdLineReplicas.append(endpoint); }
+
     QString get_theme_name();
     void set_theme_name(QString theme_name);
             
@@ -118,12 +136,34 @@ public:
 
     static bool    addToZcashConf(QString confLocation, QString line);
     static bool    removeFromZcashConf(QString confLocation, QString option);
+    static bool    isInZcashConf(QString confLocation, QString option);
 
     static const QString labelRegExp;
 
     static const int     updateSpeed         = 20 * 1000;        // 20 sec
     static const int     quickUpdateSpeed    = 5  * 1000;        // 5 sec
     static const int     priceRefreshSpeed   = 60 * 60 * 1000;   // 1 hr
+    static const int     batchRPCTimeout     = 2 * 60 * 1000;    // 2 min
+    static const int     rescanStatusTTL     = 2 * 1000;         // 2 sec
+    static const int     rpcTimeout          = 60 * 1000;        // 1 min
+    static const int     rpcMetricsLogSpeed  = 5 * 60 * 1000;    // 5 min
+    static const int     endpointRetryDelay  = 30 * 1000;        // 30 sec
+    static const int     primaryAfterWrite   = 10 * 1000;        // 10 sec of reads on the primary after a wallet change
+    static const int     pipelinedConnections = 2;
+    static const int     batchRetryDelay     = 500;              // 0.5 sec, doubled on every retry
+    static const int     maxBatchRetryDelay  = 15 * 1000;        // 15 sec
+    static const int     maxBatchRetries     = 8;
+    static const int     maxRPCRetries       = 3;
+    static const int     rpcRetryBaseDelay   = 250;              // 0.25 sec, doubled on every retry
+    static const int     rpcRetryMaxDelay    = 8 * 1000;         // 8 sec
+    static const int     refreshCycleTimeout = 90 * 1000;        // 1.5 min without a stage finishing, a bit over rpcTimeout
+    static const int     notifyFallbackSpeed = 2 * 60 * 1000;    // 2 min, polling when ycashd pushes notifications
+    static const int     syncUpdateSpeed     = 60 * 1000;        // 1 min, while ycashd is syncing
+    static const int     hiddenUpdateSpeed   = 60 * 1000;        // 1 min, while the window is hidden or headless
+    static const int     userActivityWindow  = 60 * 1000;        // 1 min after the user last did something
+    static const int     receivedZResyncBlocks = 100;            // Fetch all received y-txs at least this often
+    static const int     settledConfirmations = 10;              // Deep enough that a reorg won't touch it
+    static const int     historyPageSize     = 500;              // listtransactions entries per call while backfilling
 
 private:
     // This class can only be accessed through Settings::getInstance()
@@ -141,6 +181,8 @@ private:
     bool    _useEmbedded      = false;
     bool    _headless         = false;
     int     _peerConnections  = 0;
+
+    QStringList _cmdLineReplicas;
     
     double  zecPrice          = 0.0;
 };
@@ -0,0 +1,136 @@
+#include "txcache.h"
+#include "settings.h"
+
+/// Get the location of the cache file. Kept apart for testnet, like the sent tx store.
+QString TxCache::writeableFile() {
+    auto filename = QStringLiteral("txcache.dat");
+
+    auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    if (!dir.exists())
+        QDir().mkpath(dir.absolutePath());
+
+    if (Settings::getInstance()->isTestnet()) {
+        return dir.filePath("testnet-" % filename);
+    } else {
+        return dir.filePath(filename);
+    }
+}
+
+void TxCache::load() {
+    // Testnet isn't known until ycashd has answered, so wait for the first use
+    if (loaded)
+        return;
+    loaded = true;
+
+    QFile data(writeableFile());
+    if (!data.open(QFile::ReadOnly))
+        return;
+
+    auto jsonDoc = QJsonDocument::fromJson(data.readAll());
+    data.close();
+
+    auto txs = jsonDoc.object();
+    for (auto it = txs.constBegin(); it != txs.constEnd(); it++) {
+        auto tx = it.value().toObject();
+        entries[it.key()] = Entry{ tx["datetime"].toVariant().toLongLong(),
+                                   tx["blocktime"].toVariant().toLongLong(),
+                                   tx["blockhash"].toString(),
+                                   tx["height"].toInt() };
+    }
+}
+
+void TxCache::save() {
+    if (!dirty)
+        return;
+
+    // Same as the sent txs, only keep y-tx history on disk if the user allows it
+    if (!Settings::getInstance()->getSaveZtxs()) {
+        QFile::remove(writeableFile());
+        dirty = false;
+        return;
+    }
+
+    QJsonObject txs;
+    for (auto it = entries.constBegin(); it != entries.constEnd(); it++) {
+        QJsonObject tx;
+        tx["datetime"]  = it.value().datetime;
+        tx["blocktime"] = it.value().blocktime;
+        tx["blockhash"] = it.value().blockhash;
+        tx["height"]    = it.value().height;
+
+        txs[it.key()] = tx;
+    }
+
+    QFile data(writeableFile());
+    if (!data.open(QFile::WriteOnly | QFile::Truncate))
+        return;
+
+    data.write(QJsonDocument(txs).toJson(QJsonDocument::Compact));
+    data.close();
+
+    dirty = false;
+}
+
+bool TxCache::lookup(const QString& txid, int height, TxDetails* details) {
+    load();
+
+    auto it = entries.constFind(txid);
+    if (it == entries.constEnd())
+        return false;
+
+    details->datetime      = it->datetime;
+    details->blocktime     = it->blocktime;
+    details->blockhash     = it->blockhash;
+    details->height        = it->height;
+    details->confirmations = height - it->height + 1;
+
+    return true;
+}
+
+void TxCache::add(const QString& txid, const TxDetails& details) {
+    // Working the height out from the confirmations would be off by one if a block came in while 
+    // the tx was fetched, and the blocks check would then see a reorg that didn't happen
+    if (details.blockhash.isEmpty() || details.height <= 0 ||
+            details.confirmations < Settings::getInstance()->getTxCacheDepth())
+        return;
+
+    load();
+
+    entries[txid] = Entry{ details.datetime, details.blocktime, details.blockhash, details.height };
+    dirty = true;
+}
+
+QList<QPair<int, QString>> TxCache::blocks() {
+    load();
+
+    QMap<int, QString> heights;
+    for (auto& entry : entries) {
+        heights[entry.height] = entry.blockhash;
+    }
+
+    QList<QPair<int, QString>> blocks;
+    for (auto it = heights.constBegin(); it != heights.constEnd(); it++) {
+        blocks.push_front(qMakePair(it.key(), it.value()));
+    }
+
+    return blocks;
+}
+
+void TxCache::drop(const QSet<int>& heights) {
+    for (auto it = entries.begin(); it != entries.end(); ) {
+        if (heights.contains(it->height)) {
+            it = entries.erase(it);
+            dirty = true;
+        } else {
+            it++;
+        }
+    }
+}
+
+void TxCache::clear() {
+    entries.clear();
+    loaded = true;
+    dirty  = false;
+
+    QFile::remove(writeableFile());
+}
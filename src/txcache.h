@@ -0,0 +1,51 @@
+#ifndef TXCACHE_H
+#define TXCACHE_H
+
+#include "precompiled.h"
+#include "rpcdecoder.h"
+
+/**
+ * On-disk cache of the gettransaction details of txs that are buried deep enough not to change
+ * any more, keyed by txid. A cached tx keeps the block it was mined in, so its confirmations can
+ * be worked out from the current height without asking ycashd. If that block is no longer in the
+ * chain after a reorg, the tx is dropped from the cache and fetched again.
+ */
+class TxCache {
+public:
+    // Fills in the details of a cached tx as of the given block height. Returns false if the tx
+    // isn't cached.
+    bool    lookup(const QString& txid, int height, TxDetails* details);
+
+    // Remember the details of a tx, if it is deep enough and the height of its block was looked up
+    void    add(const QString& txid, const TxDetails& details);
+
+    // The blocks the cached txs were mined in, highest first
+    QList<QPair<int, QString>>  blocks();
+
+    // Drop the txs that were mined in the given blocks
+    void    drop(const QSet<int>& heights);
+
+    // Write the cache out if anything was added or dropped
+    void    save();
+
+    void    clear();
+
+    int     size()  { load(); return entries.size(); }
+
+private:
+    struct Entry {
+        qint64  datetime;
+        qint64  blocktime;
+        QString blockhash;
+        int     height;
+    };
+
+    void    load();
+    static QString writeableFile();
+
+    QHash<QString, Entry>   entries;
+    bool                    loaded  = false;
+    bool                    dirty   = false;
+};
+
+#endif // TXCACHE_H
@@ -0,0 +1,87 @@
+#include "txhistory.h"
+
+// The output tells apart two entries of one tx that pay the same amount to the same address
+QString TxHistory::entryKey(const TransactionItem& tx) {
+    return tx.txid % tx.type % tx.address % QString::number(tx.amount, 'f', 8) % ":" % QString::number(tx.vout);
+}
+
+bool TxHistory::addPage(const QList<TransactionItem>& page, int pageSize) {
+    // New txs push the older ones further back while we're paging, so the start of a page can
+    // repeat the end of the one before it.
+    QSet<QString> keys;
+    for (auto tx : page) {
+        auto key = entryKey(tx);
+        keys.insert(key);
+        if (pagedEntries.contains(key))
+            continue;
+
+        txs[tx.txid].push_back(tx);
+    }
+
+    pagedEntries.unite(keys);
+    skip += page.size();
+
+    if (page.size() < pageSize) {
+        backfilled = true;
+        pagedEntries.clear();
+    }
+
+    return backfilled;
+}
+
+void TxHistory::merge(const SinceBlock& since) {
+    // listsinceblock reports every entry of a tx, so they replace whatever we had for it
+    QHash<QString, QList<TransactionItem>> changed;
+    for (auto& tx : since.transactions) {
+        changed[tx.txid].push_back(tx);
+    }
+
+    for (auto it = changed.constBegin(); it != changed.constEnd(); it++) {
+        txs[it.key()] = it.value();
+    }
+
+    if (!since.lastBlock.isEmpty())
+        anchorHash = since.lastBlock;
+}
+
+QSet<QString> TxHistory::unresolvedBlocks() const {
+    QSet<QString> blocks;
+    for (auto& entries : txs) {
+        for (auto& tx : entries) {
+            if (tx.height == 0 && !tx.blockhash.isEmpty())
+                blocks.insert(tx.blockhash);
+        }
+    }
+
+    return blocks;
+}
+
+void TxHistory::setHeights(const QHash<QString, int>& blockHeights) {
+    for (auto& entries : txs) {
+        for (auto& tx : entries) {
+            if (tx.height == 0 && !tx.blockhash.isEmpty())
+                tx.height = blockHeights.value(tx.blockhash, 0);
+        }
+    }
+}
+
+QList<TransactionItem> TxHistory::transactions(int tip) const {
+    QList<TransactionItem> all;
+    for (auto& entries : txs) {
+        for (auto tx : entries) {
+            if (tx.height == 0)
+                tx.setMinedAt(tip);
+            all.push_back(tx);
+        }
+    }
+
+    return all;
+}
+
+void TxHistory::clear() {
+    txs.clear();
+    pagedEntries.clear();
+    anchorHash.clear();
+    skip       = 0;
+    backfilled = false;
+}
@@ -0,0 +1,51 @@
+#ifndef TXHISTORY_H
+#define TXHISTORY_H
+
+#include "precompiled.h"
+#include "rpcdecoder.h"
+
+/**
+ * The wallet's full transparent tx history. It is paged in once with listtransactions, and kept
+ * up to date after that with listsinceblock, so each refresh only downloads what's new. The hash
+ * of the best block is taken before the first page is asked for, so anything that comes in while
+ * the history is being paged in is picked up by the first listsinceblock.
+ */
+class TxHistory {
+public:
+    // The block to ask listsinceblock from. Empty until the backfill has started.
+    const QString&  anchor() const          { return anchorHash; }
+    void            setAnchor(const QString& hash) { anchorHash = hash; }
+
+    bool    isBackfilled() const    { return backfilled; }
+
+    // Where the next listtransactions page starts
+    int     nextSkip() const        { return skip; }
+
+    // A page of listtransactions. Returns true if it was the last.
+    bool    addPage(const QList<TransactionItem>& page, int pageSize);
+
+    // Replace the entries of every tx that listsinceblock reported, and move the anchor on
+    void    merge(const SinceBlock& since);
+
+    // The blocks of mined entries whose height hasn't been filled in yet, and filling them in from
+    // the looked up block heights. An entry keeps its height, so it's never looked up again.
+    QSet<QString>   unresolvedBlocks() const;
+    void            setHeights(const QHash<QString, int>& blockHeights);
+
+    // Entries whose block height couldn't be looked up yet get one from their confirmations at tip
+    QList<TransactionItem>  transactions(int tip) const;
+
+    // Start over, e.g. after a rescan turned up txs in blocks before the anchor
+    void    clear();
+
+private:
+    static QString entryKey(const TransactionItem& tx);
+
+    QHash<QString, QList<TransactionItem>>  txs;            // By txid
+    QSet<QString>                           pagedEntries;   // While backfilling
+    QString                                 anchorHash;
+    int                                     skip        = 0;
+    bool                                    backfilled  = false;
+};
+
+#endif // TXHISTORY_H
@@ -1,6 +1,7 @@
 #include "txtablemodel.h"
 #include "settings.h"
 #include "controller.h"
+#include "workerpool.h"
 
 TxTableModel::TxTableModel(QObject *parent)
      : QAbstractTableModel(parent) {
@@ -16,25 +17,42 @@ TxTableModel::~TxTableModel() {
 
 void TxTableModel::addZSentData(const QList<TransactionItem>& data) {
     delete zsTrans;
-    zsTrans = new QList<TransactionItem>();
-    std::copy(data.begin(), data.end(), std::back_inserter(*zsTrans));
+    zsTrans = new QList<TransactionItem>(data);
 
     updateAllData();
 }
 
 void TxTableModel::addZRecvData(const QList<TransactionItem>& data) {
     delete zrTrans;
-    zrTrans = new QList<TransactionItem>();
-    std::copy(data.begin(), data.end(), std::back_inserter(*zrTrans));
+    zrTrans = new QList<TransactionItem>(data);
 
     updateAllData();
 }
 
 
+void TxTableModel::setTipHeight(int height) {
+    if (height == tipHeight)
+        return;
+
+    tipHeight = height;
+    if (modeldata == nullptr || modeldata->isEmpty())
+        return;
+
+    // Only the confirmations column changes
+    dataChanged(index(0, Column::Confirmations), index(modeldata->size() - 1, Column::Confirmations));
+}
+
+long TxTableModel::confirmations(const TransactionItem& tx) const {
+    // Txs that aren't mined yet, or were fetched before the tip was known, keep what ycashd said
+    if (tx.height <= 0 || tipHeight < tx.height)
+        return tx.confirmations;
+
+    return tipHeight - tx.height + 1;
+}
+
 void TxTableModel::addTData(const QList<TransactionItem>& data) {
     delete tTrans;
-    tTrans = new QList<TransactionItem>();
-    std::copy(data.begin(), data.end(), std::back_inserter(*tTrans));
+    tTrans = new QList<TransactionItem>(data);
 
     updateAllData();
 }
@@ -71,23 +89,36 @@ bool TxTableModel::exportToCsv(QString fileName) const {
 }
 
 void TxTableModel::updateAllData() {    
-    auto newmodeldata = new QList<TransactionItem>();
-
-    if (tTrans  != nullptr) std::copy( tTrans->begin(),  tTrans->end(), std::back_inserter(*newmodeldata));
-    if (zsTrans != nullptr) std::copy(zsTrans->begin(), zsTrans->end(), std::back_inserter(*newmodeldata));
-    if (zrTrans != nullptr) std::copy(zrTrans->begin(), zrTrans->end(), std::back_inserter(*newmodeldata));
-
-    // Sort by reverse time
-    std::sort(newmodeldata->begin(), newmodeldata->end(), [=] (auto a, auto b) {
-        return a.datetime > b.datetime; // reverse sort
+    // The lists are implicitly shared, so the worker gets them without a copy being made here
+    QList<TransactionItem> t  = tTrans  != nullptr ? *tTrans  : QList<TransactionItem>();
+    QList<TransactionItem> zs = zsTrans != nullptr ? *zsTrans : QList<TransactionItem>();
+    QList<TransactionItem> zr = zrTrans != nullptr ? *zrTrans : QList<TransactionItem>();
+
+    // Sorting a long history takes a while, so it's done on a worker
+    int run = ++sortRun;
+    WorkerPool::run<QList<TransactionItem>>([=] () {
+        QList<TransactionItem> all;
+        all.reserve(t.size() + zs.size() + zr.size());
+        all << t << zs << zr;
+
+        // Sort by reverse time
+        std::sort(all.begin(), all.end(), [=] (const TransactionItem& a, const TransactionItem& b) {
+            return a.datetime > b.datetime; // reverse sort
+        });
+
+        return all;
+    }, [=] (const QList<TransactionItem>& sorted) {
+        // A newer sort is on its way
+        if (run != sortRun)
+            return;
+
+        // And then swap out the modeldata with the new one.
+        delete modeldata;
+        modeldata = new QList<TransactionItem>(sorted);
+
+        dataChanged(index(0, 0), index(modeldata->size()-1, columnCount(index(0,0))-1));
+        layoutChanged();
     });
-
-    // And then swap out the modeldata with the new one.
-    delete modeldata;
-    modeldata = newmodeldata;
-
-    dataChanged(index(0, 0), index(modeldata->size()-1, columnCount(index(0,0))-1));
-    layoutChanged();
 }
 
  int TxTableModel::rowCount(const QModelIndex&) const
@@ -111,7 +142,7 @@ void TxTableModel::updateAllData() {
 
     auto dat = modeldata->at(index.row());
     if (role == Qt::ForegroundRole) {
-        if (dat.confirmations <= 0) {
+        if (confirmations(dat) <= 0) {
             QBrush b;
             b.setColor(Qt::red);
             return b;
@@ -134,7 +165,7 @@ void TxTableModel::updateAllData() {
                         return addr;
                 }
         case Column::Time: return QDateTime::fromMSecsSinceEpoch(dat.datetime *  (qint64)1000).toLocalTime().toString();
-        case Column::Confirmations: return QString::number(dat.confirmations);
+        case Column::Confirmations: return QString::number(confirmations(dat));
         case Column::Amount: return Settings::getZECDisplayFormat(dat.amount);
         }
     } 
@@ -158,7 +189,7 @@ void TxTableModel::updateAllData() {
                         return addr;
                 }
         case Column::Time: return QDateTime::fromMSecsSinceEpoch(modeldata->at(index.row()).datetime * (qint64)1000).toLocalTime().toString();
-        case Column::Confirmations: return QString("%1 Network Confirmations").arg(QString::number(dat.confirmations));
+        case Column::Confirmations: return QString("%1 Network Confirmations").arg(QString::number(confirmations(dat)));
         case Column::Amount: return Settings::getInstance()->getUSDFormat(modeldata->at(index.row()).amount);
         }    
     }
@@ -213,7 +244,7 @@ QString TxTableModel::getMemo(int row) const {
 }
 
 qint64 TxTableModel::getConfirmations(int row) const {
-    return modeldata->at(row).confirmations;
+    return confirmations(modeldata->at(row));
 }
 
 QString TxTableModel::getAddr(int row) const {
@@ -24,6 +24,10 @@ public:
     void addZSentData(const QList<TransactionItem>& data);
     void addZRecvData(const QList<TransactionItem>& data);     
 
+    // A new block came in. The confirmations of mined txs are counted from it, so they are 
+    // updated without asking ycashd.
+    void setTipHeight(int height);
+
     QString  getTxId(int row) const;
     QString  getMemo(int row) const;
     QString  getAddr(int row) const;
@@ -42,6 +46,8 @@ public:
 private:
     void updateAllData();
 
+    long confirmations(const TransactionItem& tx) const;
+
     QList<TransactionItem>*  tTrans      = nullptr;
     QList<TransactionItem>*  zrTrans     = nullptr;     // Z received
     QList<TransactionItem>*  zsTrans     = nullptr;     // Z sent
@@ -49,6 +55,11 @@ private:
     QList<TransactionItem>* modeldata    = nullptr;
 
     QList<QString>           headers;
+
+    int                      tipHeight   = 0;
+
+    // The latest sort sent to the worker pool. Older ones that finish late are thrown away.
+    int                      sortRun     = 0;
 };
 
 
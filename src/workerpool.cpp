@@ -0,0 +1,28 @@
+#include "workerpool.h"
+
+QThreadPool* WorkerPool::pool() {
+    static QThreadPool* workers = nullptr;
+    if (workers == nullptr) {
+        // Leave a core for the GUI thread
+        workers = new QThreadPool();
+        workers->setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+    }
+
+    return workers;
+}
+
+void WorkerPool::after(const std::shared_ptr<Queue>& queue, const std::function<void(void)>& fn) {
+    queue->deliver(queue->nextTicket++, fn);
+}
+
+void WorkerPool::Queue::deliver(int ticket, const std::function<void(void)>& fn) {
+    ready[ticket] = fn;
+
+    // A result that finished early waits for the ones started before it. The counter moves on
+    // before each callback runs, so a callback that opens a dialog (and with it a nested event
+    // loop) doesn't hand back the same result twice.
+    while (ready.contains(nextDelivery)) {
+        auto next = ready.take(nextDelivery++);
+        next();
+    }
+}
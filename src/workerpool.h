@@ -0,0 +1,59 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include "precompiled.h"
+
+/**
+ * Runs the slow part of handling a reply, like decoding it or sorting what came out of it, on a
+ * pool of worker threads. The worker builds its result without touching anything the GUI thread
+ * uses, and the result is handed back through the GUI thread's event queue, so neither side ever
+ * waits on a lock. Results are handed back as soon as they're ready, so a slow decode doesn't hold
+ * up unrelated callbacks. Work that has to be handed back in the order it was started, like the 
+ * chunks of one batch, goes through the same Queue.
+ */
+class WorkerPool {
+public:
+    // Results of the work run through one queue are handed back in the order the work was started
+    class Queue {
+    private:
+        friend class WorkerPool;
+
+        void    deliver(int ticket, const std::function<void(void)>& fn);
+
+        int                                     nextTicket      = 0;
+        int                                     nextDelivery    = 0;
+        QMap<int, std::function<void(void)>>    ready;
+    };
+
+    // work runs on a worker thread, and done runs on the GUI thread with its result
+    template<class R>
+    static void run(const std::function<R(void)>& work, const std::function<void(const R&)>& done) {
+        auto watcher = new QFutureWatcher<R>();
+        QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, [=] () {
+            R result = watcher->result();
+            watcher->deleteLater();
+
+            done(result);
+        });
+        watcher->setFuture(QtConcurrent::run(pool(), work));
+    }
+
+    // The same, but done waits for the work started on the queue before this one to be handed back
+    template<class R>
+    static void run(const std::shared_ptr<Queue>& queue, const std::function<R(void)>& work, 
+                    const std::function<void(const R&)>& done) {
+        int ticket = queue->nextTicket++;
+
+        run<R>(work, [=] (const R& result) {
+            queue->deliver(ticket, [=] () { done(result); });
+        });
+    }
+
+    // Run fn on the GUI thread once everything started on the queue before it has been handed back
+    static void after(const std::shared_ptr<Queue>& queue, const std::function<void(void)>& fn);
+
+private:
+    static QThreadPool* pool();
+};
+
+#endif // WORKERPOOL_H
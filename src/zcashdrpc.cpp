@@ -1,4 +1,5 @@
 #include "zcashdrpc.h"
+#include "rpcdecoder.h"
 #include "settings.h"
 
 
@@ -16,65 +17,45 @@ void ZcashdRPC::setConnection(Connection* c) {
     }
     
     conn = c;
+
+    // Might be a different wallet
+    history.clear();
 }
 
 bool ZcashdRPC::haveConnection() {
     return conn != nullptr;
 }
 
-void ZcashdRPC::fetchTAddresses(const std::function<void(json)>& cb) {
-    if (conn == nullptr)
-        return;
-
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "getaddressesbyaccount"},
-        {"params", {""}}
+std::function<void(QNetworkReply*, const json&)> ZcashdRPC::reportError(const QString& method, 
+                                                                        const std::function<void(void)>& failed) {
+    auto connection = conn;
+    return [=] (QNetworkReply* reply, const json& parsed) {
+        connection->reportError(method, reply, parsed);
+        if (failed)
+            failed();
     };
-
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
 }
 
-void ZcashdRPC::fetchZAddresses(const std::function<void(json)>& cb) {
-    if (conn == nullptr)
-        return;
-
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "z_listaddresses"},
-    };
-
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
+void ZcashdRPC::fetchTAddresses(const std::function<void(const QList<QString>&)>& cb, 
+                                const std::function<void(void)>& failed) {
+    call<GetAddressesByAccountRPC>({ "" }, cb, reportError(GetAddressesByAccountRPC::method(), failed));
 }
 
-void ZcashdRPC::fetchTransparentUnspent(const std::function<void(json)>& cb) {
-    if (conn == nullptr)
-        return;
-
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "listunspent"},
-        {"params", {0}}             // Get UTXOs with 0 confirmations as well.
-    };
-
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
+void ZcashdRPC::fetchZAddresses(const std::function<void(const QList<QString>&)>& cb, 
+                                const std::function<void(void)>& failed) {
+    call<ZListAddressesRPC>({}, cb, reportError(ZListAddressesRPC::method(), failed));
 }
 
-void ZcashdRPC::fetchZUnspent(const std::function<void(json)>& cb) {
-    if (conn == nullptr)
-        return;
-
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "z_listunspent"},
-        {"params", {0}}             // Get UTXOs with 0 confirmations as well.
-    };
+void ZcashdRPC::fetchTransparentUnspent(const std::function<void(const UnspentList&)>& cb, 
+                                        const std::function<void(void)>& failed) {
+    // Get UTXOs with 0 confirmations as well.
+    call<ListUnspentRPC>({ 0 }, cb, reportError(ListUnspentRPC::method(), failed));
+}
 
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
+void ZcashdRPC::fetchZUnspent(const std::function<void(const UnspentList&)>& cb, 
+                                const std::function<void(void)>& failed) {
+    // Get UTXOs with 0 confirmations as well.
+    call<ZListUnspentRPC>({ 0 }, cb, reportError(ZListUnspentRPC::method(), failed));
 }
 
 void ZcashdRPC::fetchZViewingKey(QString addr, const std::function<void(json)>& cb) {
@@ -271,31 +252,70 @@ void ZcashdRPC::validateAddress(QString address, const std::function<void(json)>
     conn->doRPCWithDefaultErrorHandling(payload, cb);
 }
 
-void ZcashdRPC::fetchBalance(const std::function<void(json)>& cb) {
+/**
+ * The whole transparent tx history. The first time it is paged in with listtransactions, and after
+ * that only the txs since the last block we asked about are fetched with listsinceblock.
+ */
+void ZcashdRPC::fetchTransactions(int height, const std::function<void(const QList<TransactionItem>&)>& cb,
+                                    const std::function<void(void)>& failed) {
     if (conn == nullptr)
         return;
 
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "z_gettotalbalance"},
-        {"params", {0}}             // Get Unconfirmed balance as well.
-    };
+    if (history.isBackfilled()) {
+        int run = historyRun;
+        call<ListSinceBlockRPC>({ history.anchor() }, [=] (const SinceBlock& since) {
+            history.merge(since);
+
+            // The heights of the blocks the new entries were mined in. Working them out from the
+            // confirmations would be off by one if a block came in while they were fetched.
+            lookupBlockHeights(history.unresolvedBlocks(), [=] () {
+                // The history was started over in the meantime
+                if (run != historyRun)
+                    return;
+
+                history.setHeights(blockHeights);
+                cb(history.transactions(height));
+            }, failed);
+        }, reportError(ListSinceBlockRPC::method(), failed));
+        return;
+    }
 
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
+    int run = ++historyRun;
+    if (!history.anchor().isEmpty()) {
+        backfillTransactions(run, height, cb, failed);
+        return;
+    }
+
+    call<GetBestBlockHashRPC>({}, [=] (const QString& hash) {
+        if (run != historyRun)
+            return;
+
+        history.setAnchor(hash);
+        backfillTransactions(run, height, cb, failed);
+    }, reportError(GetBestBlockHashRPC::method(), failed));
 }
 
-void ZcashdRPC::fetchTransactions(const std::function<void(json)>& cb) {
-    if (conn == nullptr)
-        return;
+void ZcashdRPC::backfillTransactions(int run, int height, const std::function<void(const QList<TransactionItem>&)>& cb,
+                                        const std::function<void(void)>& failed) {
+    int pageSize = Settings::historyPageSize;
+    call<ListTransactionsRPC>({ "*", pageSize, history.nextSkip() }, [=] (const QList<TransactionItem>& page) {
+        // A newer fetch has taken over
+        if (run != historyRun)
+            return;
 
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "listtransactions"}
-    };
+        if (!history.addPage(page, pageSize)) {
+            backfillTransactions(run, height, cb, failed);
+            return;
+        }
 
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
+        // Catch up with whatever came in while the pages were being fetched
+        fetchTransactions(height, cb, failed);
+    }, reportError(ListTransactionsRPC::method(), failed));
+}
+
+void ZcashdRPC::resetTransactionHistory() {
+    history.clear();
+    historyRun++;
 }
 
 void ZcashdRPC::sendZTransaction(json params, const std::function<void(json)>& cb, 
@@ -319,50 +339,26 @@ void ZcashdRPC::sendZTransaction(json params, const std::function<void(json)>& c
     });
 }
 
-void ZcashdRPC::fetchInfo(const std::function<void(json)>& cb, 
+void ZcashdRPC::fetchInfo(const std::function<void(const NodeInfo&)>& cb, 
     const std::function<void(QNetworkReply*, const json&)>&  err) {
-    if (conn == nullptr)
-        return;
-
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "getinfo"}
-    };
-
-    conn->doRPCSafe(payload, cb, err); 
+    call<GetInfoRPC>({}, cb, err);
 }
 
-void ZcashdRPC::fetchBlockchainInfo(const std::function<void(json)>& cb) {
-    if (conn == nullptr)
-        return;
-
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "getblockchaininfo"}
-    };
-
-    conn->doRPCIgnoreError(payload, cb);
+void ZcashdRPC::fetchBlockchainInfo(const std::function<void(const BlockchainInfo&)>& cb) {
+    call<GetBlockchainInfoRPC>({}, cb, [=] (auto, auto) {
+        // Ignored error handling
+    });
 }
 
 void ZcashdRPC::fetchNetSolOps(const std::function<void(qint64)> cb) {
-    if (conn == nullptr)
-        return;
-
-    json payload = {
-        {"jsonrpc", "1.0"},
-        {"id", "someid"},
-        {"method", "getnetworksolps"}
-    };
-
-    conn->doRPCIgnoreError(payload, [=](const json& reply) {
-        qint64 solrate = reply.get<json::number_unsigned_t>();
-        cb(solrate);
+    call<GetNetworkSolPsRPC>({}, [=] (double solrate) {
+        cb(static_cast<qint64>(solrate));
+    }, [=] (auto, auto) {
+        // Ignored error handling
     });
 }
 
-void ZcashdRPC::fetchMigrationStatus(const std::function<void(json)>& cb) {
+void ZcashdRPC::fetchMigrationStatus(const std::function<void(json)>& cb, const std::function<void(void)>& failed) {
     if (conn == nullptr)
         return;
 
@@ -376,7 +372,7 @@ void ZcashdRPC::fetchMigrationStatus(const std::function<void(json)>& cb) {
         {"method", "z_getmigrationstatus"},
     };
     
-    conn->doRPCWithDefaultErrorHandling(payload, cb);
+    conn->doRPCSafe(payload, cb, reportError("z_getmigrationstatus", failed));
 }
 
 
@@ -397,10 +393,33 @@ void ZcashdRPC::setMigrationStatus(bool enabled) {
 }
 
 
+/**
+ * Pair each address with the key exported for it. A key that couldn't be exported has its address
+ * added to failed instead, so the export can be abandoned rather than leave it out of the backup.
+ */
+static QList<QPair<QString, QString>> exportedKeys(const QMap<QString, json>& keys, const QString& method,
+                                                   QStringList& failed) {
+    QList<QPair<QString, QString>> allKeys;
+    for (auto it = keys.constBegin(); it != keys.constEnd(); it++) {
+        if (!it.value().is_string()) {
+            failed << it.key();
+            continue;
+        }
+
+        allKeys.push_back(QPair<QString, QString>(it.key(), QString::fromStdString(it.value().get<json::string_t>())));
+    }
+
+    if (!failed.isEmpty())
+        qDebug() << method << "failed for" << failed.size() << "addresses:" << failed.join(", ");
+
+    return allKeys;
+}
+
 /**
  * Method to export all full viewing keys at once
  */ 
-void ZcashdRPC::fetchAllViewingKeys(const std::function<void(QList<QPair<QString, QString>>)> cb) {
+void ZcashdRPC::fetchAllViewingKeys(const std::function<void(QList<QPair<QString, QString>>)> cb,
+                                    const std::function<void(QStringList)>& failed) {
     if (conn == nullptr) {
         // No connection, just return
         return;
@@ -432,17 +451,17 @@ void ZcashdRPC::fetchAllViewingKeys(const std::function<void(QList<QPair<QString
                 return payload;
             },
             [=] (QMap<QString, json>* privkeys) {
-                QList<QPair<QString, QString>> allKeys;
-                for (QString addr: privkeys->keys()) {
-                    allKeys.push_back(
-                        QPair<QString, QString>(
-                            addr, 
-                            QString::fromStdString(privkeys->value(addr).get<json::string_t>())));
-                }
-
-                cb(allKeys);
+                QStringList notExported;
+                auto keys = exportedKeys(*privkeys, "z_exportviewingkey", notExported);
                 delete privkeys;
-            }
+
+                if (notExported.isEmpty())
+                    cb(keys);
+                else
+                    failed(notExported);
+            },
+            // A chunk of the batch was lost, so it's not known which of the keys are missing
+            [=] () { failed(addrs); }
         );
     });
 }
@@ -450,7 +469,8 @@ void ZcashdRPC::fetchAllViewingKeys(const std::function<void(QList<QPair<QString
 /**
  * Method to export all full viewing keys at once
  */
-void ZcashdRPC::fetchAllIVK(const std::function<void(QList<QPair<QString, QString>>)> cb) {
+void ZcashdRPC::fetchAllIVK(const std::function<void(QList<QPair<QString, QString>>)> cb,
+                            const std::function<void(QStringList)>& failed) {
     if (conn == nullptr) {
         // No connection, just return
         return;
@@ -482,17 +502,17 @@ void ZcashdRPC::fetchAllIVK(const std::function<void(QList<QPair<QString, QStrin
                 return payload;
             },
             [=] (QMap<QString, json>* privkeys) {
-                QList<QPair<QString, QString>> allKeys;
-                for (QString addr: privkeys->keys()) {
-                    allKeys.push_back(
-                        QPair<QString, QString>(
-                            addr,
-                            QString::fromStdString(privkeys->value(addr).get<json::string_t>())));
-                }
-
-                cb(allKeys);
+                QStringList notExported;
+                auto keys = exportedKeys(*privkeys, "z_exportivk", notExported);
                 delete privkeys;
-            }
+
+                if (notExported.isEmpty())
+                    cb(keys);
+                else
+                    failed(notExported);
+            },
+            // A chunk of the batch was lost, so it's not known which of the keys are missing
+            [=] () { failed(addrs); }
         );
     });
 }
@@ -503,7 +523,8 @@ void ZcashdRPC::fetchAllIVK(const std::function<void(QList<QPair<QString, QStrin
  * combine the result, and call the callback with a single list containing both the s-addr and y-addr
  * private keys
  */ 
-void ZcashdRPC::fetchAllPrivKeys(const std::function<void(QList<QPair<QString, QString>>)> cb) {
+void ZcashdRPC::fetchAllPrivKeys(const std::function<void(QList<QPair<QString, QString>>)> cb,
+                                 const std::function<void(QStringList)>& failed) {
     if (conn == nullptr) {
         // No connection, just return
         return;
@@ -512,21 +533,27 @@ void ZcashdRPC::fetchAllPrivKeys(const std::function<void(QList<QPair<QString, Q
     // A special function that will call the callback when two lists have been added
     auto holder = new QPair<int, QList<QPair<QString, QString>>>();
     holder->first = 0;  // This is the number of times the callback has been called, initialized to 0
-    auto fnCombineTwoLists = [=] (QList<QPair<QString, QString>> list) {
+    auto notExported = std::make_shared<QStringList>();
+    auto fnCombineTwoLists = [=] (QList<QPair<QString, QString>> list, QStringList listFailed) {
         // Increment the callback counter
         holder->first++;    
 
         // Add all
         std::copy(list.begin(), list.end(), std::back_inserter(holder->second));
+        *notExported << listFailed;
         
         // And if the caller has been called twice, do the parent callback with the 
-        // collected list
+        // collected list, unless some of the keys are missing from it
         if (holder->first == 2) {
-            // Sort so z addresses are on top
-            std::sort(holder->second.begin(), holder->second.end(), 
-                        [=] (auto a, auto b) { return a.first > b.first; });
-
-            cb(holder->second);
+            if (notExported->isEmpty()) {
+                // Sort so z addresses are on top
+                std::sort(holder->second.begin(), holder->second.end(), 
+                            [=] (auto a, auto b) { return a.first > b.first; });
+
+                cb(holder->second);
+            } else {
+                failed(*notExported);
+            }
             delete holder;
         }            
     };
@@ -552,17 +579,14 @@ void ZcashdRPC::fetchAllPrivKeys(const std::function<void(QList<QPair<QString, Q
                     return payload;
                 },
                 [=] (QMap<QString, json>* privkeys) {
-                    QList<QPair<QString, QString>> allTKeys;
-                    for (QString addr: privkeys->keys()) {
-                        allTKeys.push_back(
-                            QPair<QString, QString>(
-                                addr, 
-                                QString::fromStdString(privkeys->value(addr).get<json::string_t>())));
-                    }
-
-                    fnCombineTwoLists(allTKeys);
+                    QStringList listFailed;
+                    auto keys = exportedKeys(*privkeys, QString::fromStdString(privKeyDumpMethodName), listFailed);
                     delete privkeys;
-                }
+
+                    fnCombineTwoLists(keys, listFailed);
+                },
+                // A chunk of the batch was lost, so it's not known which of the keys are missing
+                [=] () { fnCombineTwoLists({}, addrs); }
             );
         });
     };
@@ -599,13 +623,133 @@ void ZcashdRPC::fetchOpStatus(const std::function<void(json)>& cb) {
     conn->doRPCIgnoreError(payload, cb);
 }
 
-void ZcashdRPC::fetchReceivedTTrans(QList<QString> txids, QList<TransactionItem> sentZTxs,
-                const std::function<void(QList<TransactionItem>)> txdataFn) {
+/**
+ * The block a tx was mined in. It's the height looked up from the tx's block hash if there is one, 
+ * since working it out from the confirmations is off by one if a block came in while it was fetched.
+ */
+static void setMinedHeight(TransactionItem& tx, const TxDetails& details, int height) {
+    if (details.height > 0) {
+        tx.height = details.height;
+    } else {
+        tx.setMinedAt(height);
+    }
+}
+
+/**
+ * Look up the heights of the given blocks with getblockheader, and remember them. Blocks that were
+ * looked up before aren't asked for again.
+ */
+void ZcashdRPC::lookupBlockHeights(const QSet<QString>& blocks, const std::function<void(void)>& cb,
+                                    const std::function<void(void)>& failed) {
+    QList<QString> lookup;
+    for (auto& blockhash : blocks) {
+        if (!blockHeights.contains(blockhash))
+            lookup.push_back(blockhash);
+    }
+
+    if (lookup.isEmpty()) {
+        cb();
+        return;
+    }
+
+    conn->doBatchRPCDecoded<QString, int>(lookup,
+        [=] (QString blockhash) {
+            json payload = {
+                {"jsonrpc", "1.0"},
+                {"id", "blockheader"},
+                {"method", "getblockheader"},
+                {"params", {blockhash.toStdString(), true}}
+            };
+
+            return payload;
+        },
+        [=] (const QByteArray& body) {
+            BlockHeightsDecoder decoder;
+            decoder.decode(body);
+            return decoder.heights;
+        },
+        0,
+        [=] (QMap<QString, int>* heights) {
+            // A block that was reorged away in the meantime has no height
+            for (auto it = heights->constBegin(); it != heights->constEnd(); it++) {
+                if (it.value() > 0)
+                    blockHeights[it.key()] = it.value();
+            }
+            delete heights;
+
+            cb();
+        },
+        failed
+    );
+}
+
+/**
+ * Look up the heights of the blocks that the txs deep enough to be settled were mined in, and
+ * fill them into the details.
+ */
+void ZcashdRPC::resolveHeights(std::shared_ptr<QMap<QString, TxDetails>> details, const std::function<void(void)>& cb,
+                                const std::function<void(void)>& failed) {
+    QSet<QString> blocks;
+    for (auto& tx : *details) {
+        if (!tx.blockhash.isEmpty() && tx.confirmations >= Settings::getInstance()->getTxCacheDepth())
+            blocks.insert(tx.blockhash);
+    }
+
+    lookupBlockHeights(blocks, [=] () {
+        for (auto& tx : *details) {
+            if (!tx.blockhash.isEmpty())
+                tx.height = blockHeights.value(tx.blockhash, 0);
+        }
+
+        cb();
+    }, failed);
+}
+
+void ZcashdRPC::fetchReceivedTTrans(QList<QString> txids, QList<TransactionItem> sentZTxs, int height,
+                const std::function<void(QList<TransactionItem>, QMap<QString, int>)> txdataFn, 
+                const std::function<void(void)>& failed) {
     if (conn == nullptr)
         return;
 
-    // Look up all the txids to get the confirmation count for them.
-    conn->doBatchRPC<QString>(txids,
+    // Txs that are deep enough get their confirmation count from the tx cache
+    QMap<QString, TxDetails> known;
+    QList<QString> lookup;
+    for (auto& txid : txids) {
+        TxDetails details{ 0, 0 };
+        if (txCache.lookup(txid, height, &details)) {
+            known[txid] = details;
+        } else {
+            lookup.push_back(txid);
+        }
+    }
+
+    // Update the original sent list with the confirmation count
+    auto fnUpdate = [=] (const QMap<QString, TxDetails>& txidDetails) {
+        auto newSentZTxs = sentZTxs;
+        for (TransactionItem& sentTx: newSentZTxs) {
+            if (txidDetails.contains(sentTx.txid)) {
+                sentTx.confirmations = txidDetails[sentTx.txid].confirmations;
+                setMinedHeight(sentTx, txidDetails[sentTx.txid], height);
+            }
+        }
+
+        // Only the heights that were looked up are exact enough to be kept
+        QMap<QString, int> mined;
+        for (auto it = txidDetails.constBegin(); it != txidDetails.constEnd(); it++) {
+            if (it.value().height > 0 && it.value().confirmations >= Settings::getInstance()->getTxCacheDepth())
+                mined[it.key()] = it.value().height;
+        }
+        
+        txdataFn(newSentZTxs, mined);
+    };
+
+    if (lookup.isEmpty()) {
+        fnUpdate(known);
+        return;
+    }
+
+    // Look up the rest of the txids to get the confirmation count for them.
+    conn->doBatchRPCDecoded<QString, TxDetails>(lookup,
         [=] (QString txid) {
             json payload = {
                 {"jsonrpc", "1.0"},
@@ -616,31 +760,104 @@ void ZcashdRPC::fetchReceivedTTrans(QList<QString> txids, QList<TransactionItem>
 
             return payload;
         },          
-        [=] (QMap<QString, json>* txidList) {
-            auto newSentZTxs = sentZTxs;
-            // Update the original sent list with the confirmation count
-            // TODO: This whole thing is kinda inefficient. We should probably just update the file
-            // with the confirmed block number, so we don't have to keep calling gettransaction for the
-            // sent items.
-            for (TransactionItem& sentTx: newSentZTxs) {
-                auto j = txidList->value(sentTx.txid);
-                if (j.is_null())
-                    continue;
-                auto error = j["confirmations"].is_null();
-                if (!error)
-                    sentTx.confirmations = j["confirmations"].get<json::number_integer_t>();
-            }
-            
-            txdataFn(newSentZTxs);
-            delete txidList;
-        }
+        [=] (const QByteArray& body) {
+            TxDetailsDecoder decoder;
+            decoder.decode(body);
+            return decoder.details;
+        },
+        TxDetails{ 0, 0 },
+        [=] (QMap<QString, TxDetails>* txidDetails) {
+            std::shared_ptr<QMap<QString, TxDetails>> fetched(txidDetails);
+            resolveHeights(fetched, [=] () {
+                auto details = known;
+                for (auto it = fetched->constBegin(); it != fetched->constEnd(); it++) {
+                    details[it.key()] = it.value();
+                    txCache.add(it.key(), it.value());
+                }
+                txCache.save();
+
+                fnUpdate(details);
+            }, failed);
+        },
+        failed
      );
 }
 
+/**
+ * The hash of a block commits to all the blocks before it, so if the highest block a cached tx
+ * was mined in is still in the chain, so are all the others, and one getblockhash is enough.
+ * Only after a reorg is every block checked, and the txs in the blocks that are gone are dropped.
+ */
+void ZcashdRPC::checkTxCache(const std::function<void(void)>& done, const std::function<void(void)>& failed) {
+    auto blocks = txCache.blocks();
+    if (conn == nullptr || blocks.isEmpty()) {
+        done();
+        return;
+    }
+
+    // Calls cb with the blocks whose hash isn't the one that was cached. A chunk of the batch that
+    // was lost would look like a reorg, so that fails the check instead.
+    auto fnStale = [=] (const QList<QPair<int, QString>>& toCheck, const std::function<void(QSet<int>)>& cb) {
+        QList<int> heights;
+        for (auto& block : toCheck) {
+            heights.push_back(block.first);
+        }
+
+        conn->doBatchRPCDecoded<int, QString>(heights,
+            [=] (int height) {
+                json payload = {
+                    {"jsonrpc", "1.0"},
+                    {"id", "blockhash"},
+                    {"method", "getblockhash"},
+                    {"params", {height}}
+                };
+
+                return payload;
+            },
+            [=] (const QByteArray& body) {
+                StringResultsDecoder decoder;
+                decoder.decode(body);
+                return decoder.results;
+            },
+            QString(),
+            [=] (QMap<int, QString>* hashes) {
+                QSet<int> stale;
+                for (auto& block : toCheck) {
+                    if (hashes->value(block.first) != block.second)
+                        stale.insert(block.first);
+                }
+                delete hashes;
+
+                cb(stale);
+            },
+            failed
+        );
+    };
+
+    fnStale(blocks.mid(0, 1), [=] (QSet<int> stale) {
+        if (stale.isEmpty()) {
+            done();
+            return;
+        }
+
+        fnStale(blocks, [=] (QSet<int> stale) {
+            qDebug() << "Reorg: dropping the cached txs of" << stale.size() << "blocks";
+            txCache.drop(stale);
+            txCache.save();
+
+            done();
+        });
+    });
+}
+
+void ZcashdRPC::clearTxCache() {
+    txCache.clear();
+}
+
 
 // Refresh received z txs by calling z_listreceivedbyaddress/gettransaction
-void ZcashdRPC::fetchReceivedZTrans(QList<QString> zaddrs, const std::function<void(QString)> usedAddrFn,
-        const std::function<void(QList<TransactionItem>)> txdataFn) {
+void ZcashdRPC::fetchReceivedZTrans(QList<QString> zaddrs, int height, const std::function<void(QString)> usedAddrFn,
+        const std::function<void(QList<TransactionItem>)> txdataFn, const std::function<void(void)>& failed) {
     if (conn == nullptr)
         return;
 
@@ -648,10 +865,11 @@ void ZcashdRPC::fetchReceivedZTrans(QList<QString> zaddrs, const std::function<v
     // This method is complicated because z_listreceivedbyaddress only returns the txid, and 
     // we have to make a follow up call to gettransaction to get details of that transaction. 
     // Additionally, it has to be done in batches, because there are multiple y-Addresses, 
-    // and each y-Addr can have multiple received txs. 
+    // and each y-Addr can have multiple received txs. The details of txs that are already settled
+    // come from the tx cache instead.
 
     // 1. For each y-Addr, get list of received txs    
-    conn->doBatchRPC<QString>(zaddrs,
+    conn->doBatchRPCDecoded<QString, QList<ReceivedNote>>(zaddrs,
         [=] (QString zaddr) {
             json payload = {
                 {"jsonrpc", "1.0"},
@@ -661,37 +879,79 @@ void ZcashdRPC::fetchReceivedZTrans(QList<QString> zaddrs, const std::function<v
             };
 
             return payload;
-        },          
-        [=] (QMap<QString, json>* zaddrTxids) {
+        },
+        [=] (const QByteArray& body) {
+            ReceivedNotesDecoder decoder;
+            decoder.decode(body);
+            return decoder.notes;
+        },
+        QList<ReceivedNote>(),
+        [=] (QMap<QString, QList<ReceivedNote>>* zaddrTxidsResponse) {
+            // Held by the second batch's callback, so it's freed even if that batch is dropped
+            std::shared_ptr<QMap<QString, QList<ReceivedNote>>> zaddrTxids(zaddrTxidsResponse);
+
             // Process all txids, removing duplicates. This can happen if the same address
             // appears multiple times in a single tx's outputs.
             QSet<QString> txids;
             QMap<QString, QString> memos;
+            QMap<QString, TxDetails> known;
             for (auto it = zaddrTxids->constBegin(); it != zaddrTxids->constEnd(); it++) {
                 auto zaddr = it.key();
-                for (auto& i : it.value().get<json::array_t>()) {   
+                for (auto& note : it.value()) {   
                     // Mark the address as used
                     usedAddrFn(zaddr);
 
                     // Filter out change txs
-                    if (! i["change"].get<json::boolean_t>()) {
-                        auto txid = QString::fromStdString(i["txid"].get<json::string_t>());
-                        txids.insert(txid);    
+                    if (!note.change) {
+                        TxDetails details{ 0, 0 };
+                        if (txCache.lookup(note.txid, height, &details)) {
+                            known[note.txid] = details;
+                        } else {
+                            txids.insert(note.txid);    
+                        }
 
                         // Check for Memos
-                        QString memoBytes = QString::fromStdString(i["memo"].get<json::string_t>());
-                        if (!memoBytes.startsWith("f600"))  {
-                            QString memo(QByteArray::fromHex(
-                                            QByteArray::fromStdString(i["memo"].get<json::string_t>())));
-                            if (!memo.trimmed().isEmpty())
-                                memos[zaddr + txid] = memo;
-                        }
+                        if (!note.memo.isEmpty())
+                            memos[zaddr + note.txid] = note.memo;
                     }
                 }                        
             }
 
-            // 2. For all txids, go and get the details of that txid.
-            conn->doBatchRPC<QString>(txids.toList(),
+            // Combine them both together. For every zAddr's txid, get the amount, fee, confirmations and time
+            auto fnCombine = [=] (const QMap<QString, TxDetails>& txidDetails) {
+                QList<TransactionItem> txdata;
+
+                for (auto it = zaddrTxids->constBegin(); it != zaddrTxids->constEnd(); it++) {                        
+                    auto zaddr = it.key();
+
+                    for (auto& note : it.value()) {   
+                        // Filter out change txs
+                        if (note.change)
+                            continue;
+                        
+                        auto txid  = note.txid;
+
+                        // Lookup txid in the map
+                        auto txidInfo = txidDetails.value(txid);
+
+                        TransactionItem tx{ QString("receive"), txidInfo.datetime, zaddr, txid, note.amount, 
+                                            txidInfo.confirmations, "", memos.value(zaddr + txid, "") };
+                        setMinedHeight(tx, txidInfo, height);
+                        txdata.push_front(tx);
+                    }
+                }
+
+                txdataFn(txdata);
+            };
+
+            // Everything was settled already, or nothing was received, so there is nothing to look up
+            if (txids.isEmpty()) {
+                fnCombine(known);
+                return;
+            }
+
+            // 2. For all txids that aren't settled yet, go and get the details of that txid.
+            conn->doBatchRPCDecoded<QString, TxDetails>(txids.toList(),
                 [=] (QString txid) {
                     json payload = {
                         {"jsonrpc", "1.0"},
@@ -702,45 +962,29 @@ void ZcashdRPC::fetchReceivedZTrans(QList<QString> zaddrs, const std::function<v
 
                     return payload;
                 },
-                [=] (QMap<QString, json>* txidDetails) {
-                    QList<TransactionItem> txdata;
-
-                    // Combine them both together. For every zAddr's txid, get the amount, fee, confirmations and time
-                    for (auto it = zaddrTxids->constBegin(); it != zaddrTxids->constEnd(); it++) {                        
-                        for (auto& i : it.value().get<json::array_t>()) {   
-                            // Filter out change txs
-                            if (i["change"].get<json::boolean_t>())
-                                continue;
-                            
-                            auto zaddr = it.key();
-                            auto txid  = QString::fromStdString(i["txid"].get<json::string_t>());
-
-                            // Lookup txid in the map
-                            auto txidInfo = txidDetails->value(txid);
-
-                            qint64 timestamp;
-                            if (txidInfo.find("time") != txidInfo.end()) {
-                                timestamp = txidInfo["time"].get<json::number_unsigned_t>();
-                            } else {
-                                timestamp = txidInfo["blocktime"].get<json::number_unsigned_t>();
-                            }
-                            
-                            auto amount        = i["amount"].get<json::number_float_t>();
-                            auto confirmations = static_cast<long>(txidInfo["confirmations"].get<json::number_integer_t>());
-
-                            TransactionItem tx{ QString("receive"), timestamp, zaddr, txid, amount, 
-                                                confirmations, "", memos.value(zaddr + txid, "") };
-                            txdata.push_front(tx);
+                [=] (const QByteArray& body) {
+                    TxDetailsDecoder decoder;
+                    decoder.decode(body);
+                    return decoder.details;
+                },
+                TxDetails{ 0, 0 },
+                [=] (QMap<QString, TxDetails>* txidDetails) {
+                    // Cleaned up once the heights are in
+                    std::shared_ptr<QMap<QString, TxDetails>> fetched(txidDetails);
+                    resolveHeights(fetched, [=] () {
+                        auto details = known;
+                        for (auto it = fetched->constBegin(); it != fetched->constEnd(); it++) {
+                            details[it.key()] = it.value();
+                            txCache.add(it.key(), it.value());
                         }
-                    }
-
-                    txdataFn(txdata);
+                        txCache.save();
 
-                    // Cleanup both responses;
-                    delete zaddrTxids;
-                    delete txidDetails;
-                }
+                        fnCombine(details);
+                    }, failed);
+                },
+                failed
             );
-        }
+        },
+        failed
     );
 } 
@@ -4,20 +4,14 @@
 #include "precompiled.h"
 
 #include "connection.h"
+#include "datamodel.h"
+#include "rpcmethods.h"
+#include "txcache.h"
+#include "txhistory.h"
+#include "workerpool.h"
 
 using json = nlohmann::json;
 
-struct TransactionItem {
-    QString         type;
-    qint64          datetime;
-    QString         address;
-    QString         txid;
-    double          amount;
-    long            confirmations;
-    QString         fromAddr;
-    QString         memo;
-};
-
 
 class ZcashdRPC {
 public:
@@ -28,28 +22,51 @@ public:
     void setConnection(Connection* c);
     Connection* getConnection() { return conn; }
 
-    void fetchTransparentUnspent  (const std::function<void(json)>& cb);
-    void fetchZUnspent            (const std::function<void(json)>& cb);
-    void fetchTransactions        (const std::function<void(json)>& cb);
-    void fetchZAddresses          (const std::function<void(json)>& cb);
-    void fetchTAddresses          (const std::function<void(json)>& cb);
-
-    void fetchReceivedZTrans(QList<QString> zaddrs, const std::function<void(QString)> usedAddrFn,
-        const std::function<void(QList<TransactionItem>)> txdataFn);
-    void fetchReceivedTTrans(QList<QString> txids, QList<TransactionItem> sentZtxs,
-    const std::function<void(QList<TransactionItem>)> txdataFn);
-
-    void fetchInfo(const std::function<void(json)>& cb, 
+    // Typed call for one of the methods in rpcmethods.h. The reply is decoded straight into
+    // Method::Result on a worker thread, and cb is called with it on the GUI thread. A reply that
+    // can't be decoded goes to err, with a null reply and the decode error as the message.
+    template<class Method>
+    void call(const typename Method::Params& params, 
+                const std::function<void(const typename Method::Result&)>& cb,
+                const std::function<void(QNetworkReply*, const json&)>& err);
+    template<class Method>
+    void call(const typename Method::Params& params, 
+                const std::function<void(const typename Method::Result&)>& cb);
+
+    // The fetches a refresh is made of. The error is reported as usual if one of them fails, and 
+    // then failed is called instead of cb.
+    void fetchTransparentUnspent  (const std::function<void(const UnspentList&)>& cb, 
+                                    const std::function<void(void)>& failed = nullptr);
+    void fetchZUnspent            (const std::function<void(const UnspentList&)>& cb, 
+                                    const std::function<void(void)>& failed = nullptr);
+    void fetchTransactions        (int height, const std::function<void(const QList<TransactionItem>&)>& cb,
+                                    const std::function<void(void)>& failed = nullptr);
+    void resetTransactionHistory  ();
+    void fetchZAddresses          (const std::function<void(const QList<QString>&)>& cb,
+                                    const std::function<void(void)>& failed = nullptr);
+    void fetchTAddresses          (const std::function<void(const QList<QString>&)>& cb,
+                                    const std::function<void(void)>& failed = nullptr);
+
+    void fetchReceivedZTrans(QList<QString> zaddrs, int height, const std::function<void(QString)> usedAddrFn,
+        const std::function<void(QList<TransactionItem>)> txdataFn, const std::function<void(void)>& failed = nullptr);
+    // txdataFn also gets the heights of the blocks that the txs deep enough to be settled were mined in
+    void fetchReceivedTTrans(QList<QString> txids, QList<TransactionItem> sentZtxs, int height,
+    const std::function<void(QList<TransactionItem>, QMap<QString, int>)> txdataFn, 
+    const std::function<void(void)>& failed = nullptr);
+
+    // Drop the cached txs whose blocks were reorged away
+    void checkTxCache(const std::function<void(void)>& done, const std::function<void(void)>& failed);
+    void clearTxCache();
+
+    void fetchInfo(const std::function<void(const NodeInfo&)>& cb, 
                     const std::function<void(QNetworkReply*, const json&)>& err);
-    void fetchBlockchainInfo(const std::function<void(json)>& cb);
+    void fetchBlockchainInfo(const std::function<void(const BlockchainInfo&)>& cb);
     void fetchNetSolOps(const std::function<void(qint64)> cb);
     void fetchOpStatus(const std::function<void(json)>& cb);
 
-    void fetchMigrationStatus(const std::function<void(json)>& cb);
+    void fetchMigrationStatus(const std::function<void(json)>& cb, const std::function<void(void)>& failed = nullptr);
     void setMigrationStatus(bool enabled);
 
-    void fetchBalance(const std::function<void(json)>& cb);
-
     void createNewZaddr(bool sapling, const std::function<void(json)>& cb);
     void createNewTaddr(const std::function<void(json)>& cb);
     
@@ -69,14 +86,104 @@ public:
     
     void validateAddress(QString address, const std::function<void(json)>& cb);
 
-    void fetchAllPrivKeys(const std::function<void(QList<QPair<QString, QString>>)>);
-    void fetchAllViewingKeys(const std::function<void(QList<QPair<QString, QString>>)> cb);
-    void fetchAllIVK(const std::function<void(QList<QPair<QString, QString>>)> cb);
+    void fetchAllPrivKeys(const std::function<void(QList<QPair<QString, QString>>)>,
+                          const std::function<void(QStringList)>& failed);
+    void fetchAllViewingKeys(const std::function<void(QList<QPair<QString, QString>>)> cb,
+                             const std::function<void(QStringList)>& failed);
+    void fetchAllIVK(const std::function<void(QList<QPair<QString, QString>>)> cb,
+                     const std::function<void(QStringList)>& failed);
     
     void sendZTransaction(json params, const std::function<void(json)>& cb, const std::function<void(QString)>& err);
 
 private:
+    template<class Method>
+    void decodeInBackground(const QByteArray& body,
+                                    const std::function<void(const typename Method::Result&)>& cb,
+                                    const std::function<void(QNetworkReply*, const json&)>& err);
+
+    void backfillTransactions(int run, int height, const std::function<void(const QList<TransactionItem>&)>& cb,
+                                const std::function<void(void)>& failed);
+
+    void lookupBlockHeights(const QSet<QString>& blocks, const std::function<void(void)>& cb,
+                            const std::function<void(void)>& failed);
+    void resolveHeights(std::shared_ptr<QMap<QString, TxDetails>> details, const std::function<void(void)>& cb,
+                            const std::function<void(void)>& failed);
+
+    // Reports a failed call the usual way, and then calls failed if there is one
+    std::function<void(QNetworkReply*, const json&)> reportError(const QString& method, 
+                                                                const std::function<void(void)>& failed);
+
     Connection*  conn                        = nullptr;
+
+    // The transparent tx history, and the fetch that is paging it in. A fetch whose calls were
+    // dropped by a newer refresh never finishes, so the next one takes over where it left off.
+    TxHistory                           history;
+    int                                 historyRun  = 0;
+
+    // gettransaction details of deeply confirmed txs, kept on disk. Settled txs are never looked up again.
+    TxCache                             txCache;
+
+    // The heights of the block hashes looked up so far. A block hash always has the same height.
+    QHash<QString, int>                 blockHeights;
 };
 
+template<class Method>
+void ZcashdRPC::decodeInBackground(const QByteArray& body,
+                        const std::function<void(const typename Method::Result&)>& cb,
+                        const std::function<void(QNetworkReply*, const json&)>& err) {
+    typedef std::pair<bool, typename Method::Result> Decoded;
+
+    // The callbacks run in the refresh the call was made for, so whatever they send next belongs to it too
+    auto connection = conn;
+    int  generation = conn->issuingGeneration();
+
+    // Replies to the same method are handed back in the order they came in, so an older reply 
+    // can't overwrite what a newer one showed
+    static auto queue = std::make_shared<WorkerPool::Queue>();
+
+    // The reply's buffer goes back to the pool once the worker is done with it
+    auto buffer = std::make_shared<QByteArray>(body);
+
+    WorkerPool::run<Decoded>(queue, [=] () {
+        typename Method::Decoder decoder;
+        bool ok = decoder.decode(*buffer);
+        return std::make_pair(ok, decoder.result);
+    }, [=] (const Decoded& decoded) {
+        connection->recycleBuffer(*buffer);
+
+        // A newer refresh started while this was being decoded, and would have dropped the call
+        if (connection->isStale(generation) && Connection::isCancellable(Method::method()))
+            return;
+
+        connection->withGeneration(generation, [&] () {
+            if (!decoded.first) {
+                QString message = QObject::tr("Couldn't decode the reply to %1").arg(Method::method());
+                qDebug() << message;
+                err(nullptr, json{ {"error", { {"message", message.toStdString()} }} });
+                return;
+            }
+
+            cb(decoded.second);
+        });
+    });
+}
+
+template<class Method>
+void ZcashdRPC::call(const typename Method::Params& params, 
+                        const std::function<void(const typename Method::Result&)>& cb,
+                        const std::function<void(QNetworkReply*, const json&)>& err) {
+    if (conn == nullptr)
+        return;
+
+    conn->doRPCSafeRaw(Method::method(), serializeRPC<Method>(params), [=] (const QByteArray& body) {
+        decodeInBackground<Method>(body, cb, err);
+    }, err);
+}
+
+template<class Method>
+void ZcashdRPC::call(const typename Method::Params& params, 
+                        const std::function<void(const typename Method::Result&)>& cb) {
+    call<Method>(params, cb, reportError(Method::method(), nullptr));
+}
+
 #endif // ZCASHDRPC_H
@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui network
+QT       += core gui network concurrent
 
 CONFIG += precompile_header
 
@@ -59,6 +59,17 @@ SOURCES += \
     src/rescanprogress.cpp \
     src/datamodel.cpp \
     src/controller.cpp \
+    src/rpcscheduler.cpp \
+    src/rpcdecoder.cpp \
+    src/rpcmetrics.cpp \
+    src/rpcpipeline.cpp \
+    src/rpcbatchwindow.cpp \
+    src/refreshengine.cpp \
+    src/refreshscheduler.cpp \
+    src/notifylistener.cpp \
+    src/txcache.cpp \
+    src/txhistory.cpp \
+    src/workerpool.cpp \
     src/zcashdrpc.cpp
 
 HEADERS += \
@@ -86,6 +97,18 @@ HEADERS += \
     src/rescanprogress.h \
     src/datamodel.h \
     src/controller.h \
+    src/rpcscheduler.h \
+    src/rpcdecoder.h \
+    src/rpcmetrics.h \
+    src/rpcpipeline.h \
+    src/rpcbatchwindow.h \
+    src/refreshengine.h \
+    src/refreshscheduler.h \
+    src/notifylistener.h \
+    src/rpcmethods.h \
+    src/txcache.h \
+    src/txhistory.h \
+    src/workerpool.h \
     src/zcashdrpc.h 
 
 FORMS += \